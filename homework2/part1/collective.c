@@ -0,0 +1,517 @@
+/**
+ *  \file collective.c
+ *  \brief Homework 2: MPI collective-operation microbenchmarks
+ *
+ *  Times MPI_Bcast, MPI_Gather(v), MPI_Allreduce, MPI_Alltoall(v) and
+ *  MPI_Reduce_scatter against hand-written binomial-tree, ring,
+ *  recursive-doubling and pairwise-exchange versions, over power-of-two
+ *  message sizes and over the first 2, 4, 8, ... ranks (and all of
+ *  them). Each hand-written version is first checked against the
+ *  library call it replaces.
+ *
+ *  Sizes are bytes per rank: what each rank broadcasts, contributes or
+ *  reduces, or sends to each peer for the all-to-alls. A trial is timed
+ *  from a barrier to the slowest rank's finish; as in pingpong.c there
+ *  are warm-up rounds, a trial count fitted to a time budget, and
+ *  percentiles rather than means.
+ *
+ *  Rank 0 writes coll_<op>.dat per operation, one block per rank count
+ *  (select with gnuplot's 'index'), each line starting with the size and
+ *  the median time like results.dat; see collplot.gnu.
+ *
+ *  usage: mpirun -np <P> ./collective [-m <max bytes>] [<op> ...]
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <mpi.h>
+
+#define MIN_BYTES 4 /*!< Smallest message per rank */
+#define MAX_BYTES (1 << 20) /*!< Default largest message per rank */
+#define BUFFER_CAP (64 << 20) /*!< Skip sizes needing bigger buffers than this */
+#define MIN_TRIALS 5 /*!< Fewest timing trials per size */
+#define MAX_TRIALS 500 /*!< Most timing trials per size */
+#define WARMUP_TRIALS 3 /*!< Untimed rounds before each measurement */
+#define TRIAL_BUDGET 0.2 /*!< Seconds to spend timing each size */
+#define VERIFY_COUNT 1031 /*!< Words per rank when checking; not a power of two */
+
+#define TAG_COLL 7
+
+/** A collective on 'count' ints per rank (see the file comment). */
+typedef void (*coll_fn) (int* send, int* recv, int* tmp, int count,
+                         MPI_Comm comm);
+
+/* =================================================== */
+/*
+ * Library collectives
+ */
+
+/*
+ * Receive counts and displacements for the v-collectives, count words
+ * per rank, filled by set_vcounts() before a size is timed so that the
+ * timed calls do no allocation or setup the hand-written ones skip.
+ */
+static int *v_counts = NULL, *v_displs = NULL;
+
+/** Sets v_counts and v_displs for 'count' words on each of p ranks. */
+static void set_vcounts (int count, int p)
+{
+  int r;
+  for (r = 0; r < p; ++r) {
+    v_counts[r] = count;
+    v_displs[r] = r * count;
+  }
+}
+
+static void bcast_mpi (int* send, int* recv, int* tmp, int count, MPI_Comm comm)
+{
+  (void) recv;
+  (void) tmp;
+  MPI_Bcast (send, count, MPI_INT, 0, comm);
+}
+
+static void gather_mpi (int* send, int* recv, int* tmp, int count, MPI_Comm comm)
+{
+  (void) tmp;
+  MPI_Gather (send, count, MPI_INT, recv, count, MPI_INT, 0, comm);
+}
+
+static void gatherv_mpi (int* send, int* recv, int* tmp, int count, MPI_Comm comm)
+{
+  (void) tmp;
+  MPI_Gatherv (send, count, MPI_INT, recv, v_counts, v_displs, MPI_INT, 0, comm);
+}
+
+static void allreduce_mpi (int* send, int* recv, int* tmp, int count, MPI_Comm comm)
+{
+  (void) tmp;
+  MPI_Allreduce (send, recv, count, MPI_INT, MPI_SUM, comm);
+}
+
+static void alltoall_mpi (int* send, int* recv, int* tmp, int count, MPI_Comm comm)
+{
+  (void) tmp;
+  MPI_Alltoall (send, count, MPI_INT, recv, count, MPI_INT, comm);
+}
+
+static void alltoallv_mpi (int* send, int* recv, int* tmp, int count, MPI_Comm comm)
+{
+  (void) tmp;
+  (void) count;  /* v_counts holds it */
+  MPI_Alltoallv (send, v_counts, v_displs, MPI_INT,
+                 recv, v_counts, v_displs, MPI_INT, comm);
+}
+
+static void reduce_scatter_mpi (int* send, int* recv, int* tmp, int count,
+                                MPI_Comm comm)
+{
+  (void) tmp;
+  (void) count;  /* v_counts holds it */
+  MPI_Reduce_scatter (send, recv, v_counts, MPI_INT, MPI_SUM, comm);
+}
+
+/* =================================================== */
+/*
+ * Hand-written collectives
+ */
+
+/** Binomial tree: in round k, ranks below 2^k send to rank + 2^k. */
+static void bcast_binomial (int* send, int* recv, int* tmp, int count,
+                            MPI_Comm comm)
+{
+  int rank, p, mask;
+  (void) recv;
+  (void) tmp;
+  MPI_Comm_rank (comm, &rank);
+  MPI_Comm_size (comm, &p);
+  for (mask = 1; mask < p; mask <<= 1) {
+    if (rank < mask && rank + mask < p) {
+      MPI_Send (send, count, MPI_INT, rank + mask, TAG_COLL, comm);
+    } else if (rank >= mask && rank < 2 * mask) {
+      MPI_Recv (send, count, MPI_INT, rank - mask, TAG_COLL, comm,
+                MPI_STATUS_IGNORE);
+    }
+  }
+}
+
+/**
+ *  Binomial tree gather: rank r collects the blocks of ranks r..r+2^k-1
+ *  in 'tmp' and passes them on to r - 2^k, where 2^k is r's lowest set
+ *  bit; rank 0 ends up with all of them.
+ */
+static void gather_binomial (int* send, int* recv, int* tmp, int count,
+                             MPI_Comm comm)
+{
+  int rank, p, mask;
+  MPI_Comm_rank (comm, &rank);
+  MPI_Comm_size (comm, &p);
+  int *buf = rank == 0 ? recv : tmp;
+  memcpy (buf, send, count * sizeof (int));
+  for (mask = 1; mask < p; mask <<= 1) {
+    if (rank & mask) {
+      int blocks = p - rank < mask ? p - rank : mask;
+      MPI_Send (buf, blocks * count, MPI_INT, rank - mask, TAG_COLL, comm);
+      break;
+    } else if (rank + mask < p) {
+      int blocks = p - rank - mask < mask ? p - rank - mask : mask;
+      MPI_Recv (buf + (long)mask * count, blocks * count, MPI_INT, rank + mask,
+                TAG_COLL, comm, MPI_STATUS_IGNORE);
+    }
+  }
+}
+
+/** Recursive doubling: exchange whole vectors with rank ^ 2^k. Needs 2^n ranks. */
+static void allreduce_rd (int* send, int* recv, int* tmp, int count,
+                          MPI_Comm comm)
+{
+  int rank, p, mask, i;
+  MPI_Comm_rank (comm, &rank);
+  MPI_Comm_size (comm, &p);
+  assert ((p & (p - 1)) == 0);
+  memcpy (recv, send, count * sizeof (int));
+  for (mask = 1; mask < p; mask <<= 1) {
+    MPI_Sendrecv (recv, count, MPI_INT, rank ^ mask, TAG_COLL,
+                  tmp, count, MPI_INT, rank ^ mask, TAG_COLL, comm,
+                  MPI_STATUS_IGNORE);
+    for (i = 0; i < count; ++i) {
+      recv[i] += tmp[i];
+    }
+  }
+}
+
+/** First word of segment s when 'count' words are cut into p segments. */
+static int segment (int s, int count, int p)
+{
+  return (int)((long)s * count / p);
+}
+
+/**
+ *  Ring allreduce: p-1 steps of reduce-scatter, passing one segment to
+ *  the right and adding the one from the left, then p-1 steps of
+ *  allgather. Moves 2(p-1)/p of the vector per rank, whatever p is.
+ */
+static void allreduce_ring (int* send, int* recv, int* tmp, int count,
+                            MPI_Comm comm)
+{
+  int rank, p, s, i;
+  MPI_Comm_rank (comm, &rank);
+  MPI_Comm_size (comm, &p);
+  int right = (rank + 1) % p, left = (rank + p - 1) % p;
+  memcpy (recv, send, count * sizeof (int));
+  for (s = 0; s < p - 1; ++s) {
+    int out = (rank - s + p) % p, in = (rank - s - 1 + p) % p;
+    int in0 = segment (in, count, p), in_len = segment (in + 1, count, p) - in0;
+    int out0 = segment (out, count, p);
+    MPI_Sendrecv (recv + out0, segment (out + 1, count, p) - out0, MPI_INT,
+                  right, TAG_COLL, tmp, in_len, MPI_INT, left, TAG_COLL, comm,
+                  MPI_STATUS_IGNORE);
+    for (i = 0; i < in_len; ++i) {
+      recv[in0 + i] += tmp[i];
+    }
+  }
+  /* Rank r now holds the sum of segment r+1; pass the sums around */
+  for (s = 0; s < p - 1; ++s) {
+    int out = (rank + 1 - s + p) % p, in = (rank - s + p) % p;
+    int in0 = segment (in, count, p), out0 = segment (out, count, p);
+    MPI_Sendrecv (recv + out0, segment (out + 1, count, p) - out0, MPI_INT,
+                  right, TAG_COLL, recv + in0, segment (in + 1, count, p) - in0,
+                  MPI_INT, left, TAG_COLL, comm, MPI_STATUS_IGNORE);
+  }
+}
+
+/**
+ *  Ring reduce-scatter: block b of the p*count inputs is for rank b. In
+ *  step s rank r passes its partial sum of block r-s-1 to the right and
+ *  adds the left neighbour's sum of block r-s-2, ending with block r.
+ */
+static void reduce_scatter_ring (int* send, int* recv, int* tmp, int count,
+                                 MPI_Comm comm)
+{
+  int rank, p, s, i;
+  MPI_Comm_rank (comm, &rank);
+  MPI_Comm_size (comm, &p);
+  int right = (rank + 1) % p, left = (rank + p - 1) % p;
+  int *acc = tmp, *in_buf = tmp + (long)p * count;
+  memcpy (acc, send, (long)p * count * sizeof (int));
+  for (s = 0; s < p - 1; ++s) {
+    int out = ((rank - s - 1) % p + p) % p, in = ((rank - s - 2) % p + p) % p;
+    MPI_Sendrecv (acc + (long)out * count, count, MPI_INT, right, TAG_COLL,
+                  in_buf, count, MPI_INT, left, TAG_COLL, comm,
+                  MPI_STATUS_IGNORE);
+    for (i = 0; i < count; ++i) {
+      acc[(long)in * count + i] += in_buf[i];
+    }
+  }
+  memcpy (recv, acc + (long)rank * count, count * sizeof (int));
+}
+
+/** Pairwise exchange: in step s send to rank+s while receiving from rank-s. */
+static void alltoall_pairwise (int* send, int* recv, int* tmp, int count,
+                               MPI_Comm comm)
+{
+  int rank, p, s;
+  (void) tmp;
+  MPI_Comm_rank (comm, &rank);
+  MPI_Comm_size (comm, &p);
+  for (s = 0; s < p; ++s) {
+    int dst = (rank + s) % p, src = (rank - s + p) % p;
+    MPI_Sendrecv (send + (long)dst * count, count, MPI_INT, dst, TAG_COLL,
+                  recv + (long)src * count, count, MPI_INT, src, TAG_COLL, comm,
+                  MPI_STATUS_IGNORE);
+  }
+}
+
+/* =================================================== */
+
+/** A benchmarked operation. */
+struct op_t {
+  const char* name;
+  coll_fn fn;
+  int send_blocks;  /*!< Send buffer holds this many counts, or p if 0 */
+  int recv_blocks;  /*!< Likewise for the receive buffer */
+  int checked;      /*!< Which ranks' receive buffers hold the result:
+                         0 none (bcast: the send buffer), 1 rank 0, 2 all */
+  int pow2;         /*!< Only runs on power-of-two rank counts */
+  const char* ref;  /*!< Library version to check against, or NULL */
+};
+
+static const struct op_t ops[] = {
+  { "bcast_mpi", bcast_mpi, 1, 1, 0, 0, NULL },
+  { "bcast_binomial", bcast_binomial, 1, 1, 0, 0, "bcast_mpi" },
+  { "gather_mpi", gather_mpi, 1, 0, 1, 0, NULL },
+  { "gatherv_mpi", gatherv_mpi, 1, 0, 1, 0, NULL },
+  { "gather_binomial", gather_binomial, 1, 0, 1, 0, "gather_mpi" },
+  { "allreduce_mpi", allreduce_mpi, 1, 1, 2, 0, NULL },
+  { "allreduce_ring", allreduce_ring, 1, 1, 2, 0, "allreduce_mpi" },
+  { "allreduce_rd", allreduce_rd, 1, 1, 2, 1, "allreduce_mpi" },
+  { "alltoall_mpi", alltoall_mpi, 0, 0, 2, 0, NULL },
+  { "alltoallv_mpi", alltoallv_mpi, 0, 0, 2, 0, NULL },
+  { "alltoall_pairwise", alltoall_pairwise, 0, 0, 2, 0, "alltoall_mpi" },
+  { "reduce_scatter_mpi", reduce_scatter_mpi, 0, 1, 2, 0, NULL },
+  { "reduce_scatter_ring", reduce_scatter_ring, 0, 1, 2, 0, "reduce_scatter_mpi" },
+};
+
+#define NUM_OPS ((int)(sizeof (ops) / sizeof (ops[0])))
+
+/** Fills send[0:n-1] with values depending on the rank and position. */
+static void fill (int* send, long n, int rank)
+{
+  long i;
+  for (i = 0; i < n; ++i) {
+    send[i] = (int)((rank * 7919 + i * 31) % 1000);
+  }
+}
+
+/** The result of 'op' on the test data, in recv (or send for bcast). */
+static int* check_result (const struct op_t* op, int* send, int* recv, int* tmp,
+                          int count, int p, MPI_Comm comm)
+{
+  int rank;
+  MPI_Comm_rank (comm, &rank);
+  fill (send, (long)(op->send_blocks ? op->send_blocks : p) * count, rank);
+  memset (recv, 0, (long)(op->recv_blocks ? op->recv_blocks : p) * count * sizeof (int));
+  set_vcounts (count, p);
+  op->fn (send, recv, tmp, count, comm);
+  return op->checked ? recv : send;
+}
+
+/** Asserts that 'op' gives the same result as its library version. */
+static void verify (const struct op_t* op, const struct op_t* ref, int* send,
+                    int* recv, int* tmp, int* expect, int p, MPI_Comm comm)
+{
+  int rank;
+  long n = (long)(op->recv_blocks ? op->recv_blocks : p) * VERIFY_COUNT;
+  MPI_Comm_rank (comm, &rank);
+  memcpy (expect, check_result (ref, send, recv, tmp, VERIFY_COUNT, p, comm),
+          n * sizeof (int));
+  int *got = check_result (op, send, recv, tmp, VERIFY_COUNT, p, comm);
+  if (op->checked != 1 || rank == 0) {
+    if (memcmp (expect, got, n * sizeof (int)) != 0) {
+      fprintf (stderr, "%s differs from %s on %d ranks\n", op->name, ref->name, p);
+      MPI_Abort (MPI_COMM_WORLD, 1);
+    }
+  }
+}
+
+/** For qsort(). */
+static int compare_doubles (const void* a, const void* b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/** The p-th percentile (0 <= p <= 100) of sorted[0:n-1], by nearest rank. */
+static double percentile (const double* sorted, int n, double p)
+{
+  int k = (int)(p / 100 * n + 0.5);
+  if (k < 1) k = 1;
+  if (k > n) k = n;
+  return sorted[k - 1];
+}
+
+/**
+ *  Times 'op' on 'count' words per rank. Each trial's time is the
+ *  slowest rank's, gathered once at the end; rank 0 gets them sorted in
+ *  'slowest' and the trial count is returned.
+ */
+static int measure (const struct op_t* op, int* send, int* recv, int* tmp,
+                    int count, MPI_Comm comm, double* times, double* slowest)
+{
+  int trial, trials, p;
+  double t_start;
+
+  MPI_Comm_size (comm, &p);
+  set_vcounts (count, p);
+  MPI_Barrier (comm);
+  t_start = MPI_Wtime ();
+  for (trial = 0; trial < WARMUP_TRIALS; ++trial) {
+    op->fn (send, recv, tmp, count, comm);
+  }
+  trials = (int)(TRIAL_BUDGET / ((MPI_Wtime () - t_start) / WARMUP_TRIALS));
+  if (trials < MIN_TRIALS) trials = MIN_TRIALS;
+  if (trials > MAX_TRIALS) trials = MAX_TRIALS;
+  MPI_Bcast (&trials, 1, MPI_INT, 0, comm);
+
+  for (trial = 0; trial < trials; ++trial) {
+    MPI_Barrier (comm);
+    t_start = MPI_Wtime ();
+    op->fn (send, recv, tmp, count, comm);
+    times[trial] = MPI_Wtime () - t_start;
+  }
+  MPI_Reduce (times, slowest, trials, MPI_DOUBLE, MPI_MAX, 0, comm);
+  qsort (slowest, trials, sizeof (double), compare_doubles);
+  return trials;
+}
+
+/** Whether 'name' was asked for on the command line (all if none were). */
+static int selected (const char* name, int argc, char* argv[])
+{
+  int i;
+  for (i = 1; i < argc; ++i) {
+    if (strstr (name, argv[i]) != NULL) {
+      return 1;
+    }
+  }
+  return argc <= 1;
+}
+
+/** Program start */
+int main (int argc, char *argv[])
+{
+  int rank = 0;
+  int np = 0;
+  long max_bytes = MAX_BYTES;
+  int i, o, p;
+
+  MPI_Init (&argc, &argv);	/* starts MPI */
+  MPI_Comm_rank (MPI_COMM_WORLD, &rank);	/* Get process id */
+  MPI_Comm_size (MPI_COMM_WORLD, &np);	/* Get number of processes */
+  assert (np >= 2);
+
+  /* Options first, then the names (or parts of names) of ops to run */
+  int kept = 1;
+  for (i = 1; i < argc; ++i) {
+    if (strcmp (argv[i], "-m") == 0 && i + 1 < argc) {
+      max_bytes = atol (argv[++i]);
+      assert (max_bytes >= MIN_BYTES);
+    } else {
+      argv[kept++] = argv[i];
+    }
+  }
+  argc = kept;
+
+  /* Buffers for the largest case: p blocks of the largest message */
+  long words = BUFFER_CAP / sizeof (int);
+  if (words < (long)np * VERIFY_COUNT) {
+    words = (long)np * VERIFY_COUNT;
+  }
+  int *send = (int *)malloc (words * sizeof (int));
+  int *recv = (int *)malloc (words * sizeof (int));
+  int *tmp = (int *)malloc (2 * words * sizeof (int));
+  int *expect = (int *)malloc (words * sizeof (int));
+  double *times = (double *)malloc (MAX_TRIALS * sizeof (double));
+  double *slowest = (double *)malloc (MAX_TRIALS * sizeof (double));
+  v_counts = (int *)malloc (np * sizeof (int));
+  v_displs = (int *)malloc (np * sizeof (int));
+  assert (send && recv && tmp && expect && times && slowest && v_counts && v_displs);
+  memset (send, 0, words * sizeof (int));
+
+  FILE *fp[NUM_OPS];
+  for (o = 0; o < NUM_OPS; ++o) {
+    fp[o] = NULL;
+    if (rank == 0 && selected (ops[o].name, argc, argv)) {
+      char filename[64];
+      sprintf (filename, "coll_%s.dat", ops[o].name);
+      fp[o] = fopen (filename, "w");
+      assert (fp[o] != NULL);
+    }
+  }
+
+  /* Rank counts 2, 4, 8, ... and finally np itself */
+  for (p = 2; p <= np; p = (p < np && 2 * p > np) ? np : 2 * p) {
+    MPI_Comm comm;
+    MPI_Comm_split (MPI_COMM_WORLD, rank < p ? 0 : MPI_UNDEFINED, rank, &comm);
+    if (comm != MPI_COMM_NULL) {
+      for (o = 0; o < NUM_OPS; ++o) {
+        const struct op_t* op = &ops[o];
+        if (!selected (op->name, argc, argv) || (op->pow2 && (p & (p - 1)))) {
+          continue;
+        }
+        if (op->ref) {
+          for (i = 0; i < NUM_OPS && strcmp (ops[i].name, op->ref) != 0; ++i)
+            ;
+          assert (i < NUM_OPS);
+          verify (op, &ops[i], send, recv, tmp, expect, p, comm);
+        }
+        if (rank == 0) {
+          fprintf (fp[o], "# np = %d\n# bytes\tp50\tmin\tp90\tMBps\ttrials\n", p);
+          printf ("%-20s np %4d\n", op->name, p);
+        }
+        long bytes;
+        for (bytes = MIN_BYTES; bytes <= max_bytes; bytes *= 2) {
+          int count = (int)(bytes / sizeof (int));
+          if ((long)p * bytes > BUFFER_CAP) {
+            break;
+          }
+          int trials = measure (op, send, recv, tmp, count, comm, times, slowest);
+          if (rank == 0) {
+            double t = percentile (slowest, trials, 50);
+            fprintf (fp[o], "%ld\t%.10f\t%.10f\t%.10f\t%.3f\t%d\n", bytes, t,
+                     slowest[0], percentile (slowest, trials, 90), bytes / t / 1e6,
+                     trials);
+            fflush (fp[o]);
+          }
+        }
+        /* Two blank lines start a new gnuplot index */
+        if (rank == 0) {
+          fprintf (fp[o], "\n\n");
+        }
+      }
+      MPI_Comm_free (&comm);
+    }
+    MPI_Barrier (MPI_COMM_WORLD);
+    if (p == np) {
+      break;
+    }
+  } /* p */
+
+  for (o = 0; o < NUM_OPS; ++o) {
+    if (fp[o]) {
+      fclose (fp[o]);
+    }
+  }
+  free (send);
+  free (recv);
+  free (tmp);
+  free (expect);
+  free (times);
+  free (slowest);
+  free (v_counts);
+  free (v_displs);
+  MPI_Finalize ();
+  return 0;
+}
+
+/* eof */
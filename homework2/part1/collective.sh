@@ -0,0 +1,21 @@
+#!/bin/bash
+#$ -q eecs221
+#$ -pe mpi 64
+#$ -N collective
+#$ -R y
+
+date
+hostname
+echo -e "\n\n"
+
+# Module load OpenMPI
+module load openmpi-1.8.3/gcc-4.9.2
+
+# Build: mpicc -O2 -o collective collective.c
+# Run the collective benchmarks on 2, 4, ..., 64 ranks
+mpirun -np 64 ./collective
+
+# Generate coll_*.png
+gnuplot collplot.gnu
+
+# eof
@@ -0,0 +1,18 @@
+# Median time against message size for each collective and rank count.
+# Run after ./collective; writes one PNG per operation family.
+set term png
+set log xy
+set xlabel "Message Size per Rank (Bytes)"
+set ylabel "Time (s)"
+set grid
+set key left top
+
+do for [op in "bcast gather allreduce alltoall reduce_scatter"] {
+  set output sprintf('coll_%s.png', op)
+  set title sprintf("MPI %s: library vs hand-written", op)
+  files = system(sprintf("ls coll_%s*.dat 2>/dev/null", op))
+  # Block i of a file holds the i-th '# np = ' rank count
+  plot for [f in files] for [i=0:*] f index i using 1:2 with linespoints \
+       title sprintf("%s, np %s", f[6:strlen(f)-4], \
+                     word(system(sprintf("awk '/^# np/ {print $4}' %s", f)), i+1))
+}
@@ -0,0 +1,301 @@
+/**
+ *  \file netmodel.c
+ *  \brief Homework 2: network cost models fitted to pingpong results
+ *
+ *  Reads results.dat from pingpong.c (bytes and one-way time in the
+ *  first two columns; the Ssend and streaming columns are used when
+ *  present) and fits
+ *
+ *    - alpha-beta, T(m) = alpha + beta m, separately below and above the
+ *      eager/rendezvous switch, which is found as the break point that
+ *      best splits the curve into two lines (and cross-checked against
+ *      where MPI_Send starts costing as much as MPI_Ssend),
+ *    - LogGP: L + 2o from the eager intercept, G from the rendezvous
+ *      slope, g from the streaming rate of the smallest messages.
+ *
+ *  Fits minimise relative error, since times span several decades.
+ *  The model then predicts the communication of the Mandelbrot
+ *  strategies in ../part2 for a range of chunk sizes, recommending one,
+ *  and of a sample sort of the homework 1 keys over MPI.
+ *
+ *  Build: gcc -O2 -o netmodel netmodel.c -lm
+ *  usage: ./netmodel [-H <height>] [-W <width>] [-P <ranks>]
+ *                    [-t <seconds per pixel>] [-N <keys>] [results.dat]
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_POINTS 64
+#define MIN_SEGMENT 3 /*!< Fewest points a fitted segment may have */
+#define SPLIT_GAIN 2.0 /*!< Two lines must cut the error this much to count */
+
+/** One line of results.dat; missing columns are 0. */
+struct point_t {
+  double bytes, time, ssend, uni_MBps;
+};
+
+/** T(m) = alpha + beta m, and its relative squared error on the points. */
+struct line_t {
+  double alpha, beta, err;
+  int n;  /*!< Points fitted */
+};
+
+/** The fitted network. */
+struct model_t {
+  struct line_t eager, rendezvous;
+  double split;  /*!< Smallest message sent by rendezvous; 0 if none found */
+  double L2o, G, g;
+};
+
+/**
+ *  Fits points [lo, hi) minimising the sum of ((T(m) - t)/t)^2, i.e.
+ *  weighted least squares with weights 1/t^2.
+ */
+static struct line_t fit (const struct point_t* pts, int lo, int hi)
+{
+  double sw = 0, sm = 0, st = 0, smm = 0, smt = 0;
+  int i;
+  struct line_t l;
+  for (i = lo; i < hi; ++i) {
+    double w = 1 / (pts[i].time * pts[i].time);
+    sw += w;
+    sm += w * pts[i].bytes;
+    st += w * pts[i].time;
+    smm += w * pts[i].bytes * pts[i].bytes;
+    smt += w * pts[i].bytes * pts[i].time;
+  }
+  double det = sw * smm - sm * sm;
+  l.beta = det != 0 ? (sw * smt - sm * st) / det : 0;
+  l.alpha = (st - l.beta * sm) / sw;
+  l.err = 0;
+  l.n = hi - lo;
+  for (i = lo; i < hi; ++i) {
+    double r = (l.alpha + l.beta * pts[i].bytes - pts[i].time) / pts[i].time;
+    l.err += r * r;
+  }
+  return l;
+}
+
+/** Time for an m-byte message under the fitted model. */
+static double cost (const struct model_t* model, double m)
+{
+  const struct line_t* l = model->split > 0 && m >= model->split
+    ? &model->rendezvous : &model->eager;
+  return l->alpha + l->beta * m;
+}
+
+/** Reads up to MAX_POINTS lines of results.dat; returns how many. */
+static int load (const char* filename, struct point_t* pts)
+{
+  FILE *fp = fopen (filename, "r");
+  char line[512];
+  int n = 0;
+  if (fp == NULL) {
+    perror (filename);
+    exit (1);
+  }
+  while (n < MAX_POINTS && fgets (line, sizeof (line), fp)) {
+    double c[8] = { 0 };
+    if (line[0] == '#') {
+      continue;
+    }
+    int k = sscanf (line, "%lf %lf %lf %lf %lf %lf %lf %lf",
+                    &c[0], &c[1], &c[2], &c[3], &c[4], &c[5], &c[6], &c[7]);
+    if (k < 2 || c[1] <= 0) {
+      continue;
+    }
+    pts[n].bytes = c[0];
+    pts[n].time = c[1];
+    pts[n].ssend = k >= 6 ? c[5] : 0;
+    pts[n].uni_MBps = k >= 7 ? c[6] : 0;
+    ++n;
+  }
+  fclose (fp);
+  return n;
+}
+
+/** Fits the model to pts[0:n-1], sorted by size. */
+static struct model_t fit_model (const struct point_t* pts, int n)
+{
+  struct model_t model;
+  struct line_t whole = fit (pts, 0, n);
+  int k, best = -1;
+  double best_err = whole.err;
+
+  /* Segmented regression: the split that best explains two lines */
+  for (k = MIN_SEGMENT; k <= n - MIN_SEGMENT; ++k) {
+    double err = fit (pts, 0, k).err + fit (pts, k, n).err;
+    if (err < best_err) {
+      best_err = err;
+      best = k;
+    }
+  }
+  if (best > 0 && whole.err > SPLIT_GAIN * best_err) {
+    model.eager = fit (pts, 0, best);
+    model.rendezvous = fit (pts, best, n);
+    model.split = pts[best].bytes;
+  } else {
+    model.eager = model.rendezvous = whole;
+    model.split = 0;
+  }
+
+  /* LogGP: a one-way small message costs L + 2o; long ones G per byte */
+  model.L2o = model.eager.alpha;
+  model.G = model.rendezvous.beta;
+  model.g = pts[0].uni_MBps > 0 ? pts[0].bytes / (pts[0].uni_MBps * 1e6) : 0;
+  return model;
+}
+
+/** Smallest size where MPI_Send costs at least 95% of MPI_Ssend; 0 if unknown. */
+static double ssend_switch (const struct point_t* pts, int n)
+{
+  int i;
+  if (pts[0].ssend <= 0) {
+    return 0;
+  }
+  for (i = 0; i < n; ++i) {
+    if (pts[i].time >= 0.95 * pts[i].ssend) {
+      return pts[i].bytes;
+    }
+  }
+  return 0;
+}
+
+/* =================================================== */
+
+/**
+ *  Mandelbrot (../part2) counts are 2 bytes per pixel. For each chunk of
+ *  c rows, estimates the communication and overall time of:
+ *
+ *    gather: static rows, one MPI_Gatherv, which the root receives one
+ *            rank at a time: (P-1) T(2HW/P);
+ *    farm:   rank 0 sends a task and takes a (raw, so worst-case) result
+ *            per chunk, serially: H/c (T(4) + T(2cW)). It keeps up while
+ *            that is below the P ranks' compute, and the last chunk adds
+ *            a tail of cW pixels;
+ *    steal:  each chunk is a fetch-and-add round trip and a put, spread
+ *            over the ranks, but all data still enters rank 0's link:
+ *            at least 2HW G.
+ */
+static void predict_mandelbrot (const struct model_t* m, double H, double W,
+                                double P, double tp)
+{
+  double compute = H * W * tp / P;
+  double gather = (P - 1) * cost (m, 2 * H * W / P);
+  double c, best_c = 1, best_t = INFINITY;
+
+  printf ("\nMandelbrot %gx%g on %g ranks, %.3g s per pixel:\n", H, W, P, tp);
+  printf ("  compute (perfect balance)  %10.4f s\n", compute);
+  printf ("  static gather              %10.4f s communication\n", gather);
+  printf ("  %6s %12s %12s %12s %12s\n", "chunk", "farm comm", "farm total",
+          "steal comm", "steal total");
+  for (c = 1; c <= H && c <= 1024; c *= 2) {
+    double tasks = ceil (H / c);
+    double tail = c * W * tp;
+    double farm = tasks * (cost (m, 4) + cost (m, 2 * c * W));
+    double farm_total = fmax (compute, farm) + tail;
+    double steal = tasks / P * (2 * cost (m, 4) + cost (m, 2 * c * W));
+    double link = 2 * H * W * m->G;
+    double steal_total = fmax (compute + steal, link) + tail;
+    printf ("  %6g %12.4f %12.4f %12.4f %12.4f\n", c, farm, farm_total, steal,
+            steal_total);
+    if (farm_total < best_t) {
+      best_t = farm_total;
+      best_c = c;
+    }
+  }
+  printf ("  suggested farm chunk: %g rows (-s dynamic -b %g)\n", best_c, best_c);
+}
+
+/**
+ *  Sample sort of N 4-byte keys on P ranks: samples of P-1 keys per rank
+ *  gathered to the root, P-1 splitters broadcast along a binomial tree,
+ *  an all-to-all of about N/P^2 keys per pair, and the sorted pieces
+ *  gathered back.
+ */
+static void predict_sort (const struct model_t* m, double N, double P)
+{
+  double samples = (P - 1) * cost (m, 4 * (P - 1));
+  double splitters = ceil (log2 (P)) * cost (m, 4 * (P - 1));
+  double exchange = (P - 1) * cost (m, 4 * N / (P * P));
+  double collect = (P - 1) * cost (m, 4 * N / P);
+  printf ("\nSample sort of %g keys on %g ranks:\n", N, P);
+  printf ("  gather samples   %10.6f s\n", samples);
+  printf ("  bcast splitters  %10.6f s\n", splitters);
+  printf ("  all-to-all       %10.6f s\n", exchange);
+  printf ("  gather result    %10.6f s\n", collect);
+  printf ("  total            %10.6f s\n",
+          samples + splitters + exchange + collect);
+}
+
+/** Program start */
+int main (int argc, char *argv[])
+{
+  const char *filename = "results.dat";
+  double H = 10000, W = 10000, P = 32, tp = 7.75e-7, N = 10000000;
+  struct point_t pts[MAX_POINTS];
+  int i, n;
+
+  for (i = 1; i < argc; ++i) {
+    if (argv[i][0] == '-' && argv[i][1] != '\0' && i + 1 < argc) {
+      double v = atof (argv[i + 1]);
+      switch (argv[i][1]) {
+      case 'H': H = v; break;
+      case 'W': W = v; break;
+      case 'P': P = v; break;
+      case 't': tp = v; break;
+      case 'N': N = v; break;
+      default:
+        fprintf (stderr, "usage: %s [-H <height>] [-W <width>] [-P <ranks>] "
+                 "[-t <seconds per pixel>] [-N <keys>] [results.dat]\n", argv[0]);
+        return 1;
+      }
+      ++i;
+    } else {
+      filename = argv[i];
+    }
+  }
+  assert (H > 0 && W > 0 && P >= 2 && tp > 0 && N > 0);
+
+  n = load (filename, pts);
+  if (n < 2 * MIN_SEGMENT) {
+    fprintf (stderr, "%s: need at least %d measurements\n", filename,
+             2 * MIN_SEGMENT);
+    return 1;
+  }
+  struct model_t model = fit_model (pts, n);
+
+  printf ("%d measurements from %s\n", n, filename);
+  if (model.split > 0) {
+    printf ("protocol switch at %g bytes (segmented fit)\n", model.split);
+    printf ("  eager:      alpha %.3e s  beta %.3e s/B  (%.1f MB/s)  rms rel err %.2f%%\n",
+            model.eager.alpha, model.eager.beta, 1e-6 / model.eager.beta,
+            100 * sqrt (model.eager.err / model.eager.n));
+    printf ("  rendezvous: alpha %.3e s  beta %.3e s/B  (%.1f MB/s)  rms rel err %.2f%%\n",
+            model.rendezvous.alpha, model.rendezvous.beta,
+            1e-6 / model.rendezvous.beta,
+            100 * sqrt (model.rendezvous.err / model.rendezvous.n));
+  } else {
+    printf ("no protocol switch found; one line fits\n");
+    printf ("  alpha %.3e s  beta %.3e s/B  (%.1f MB/s)\n", model.eager.alpha,
+            model.eager.beta, 1e-6 / model.eager.beta);
+  }
+  if (ssend_switch (pts, n) > 0) {
+    printf ("MPI_Send reaches MPI_Ssend cost at %g bytes\n", ssend_switch (pts, n));
+  }
+  printf ("LogGP: L + 2o = %.3e s, G = %.3e s/B", model.L2o, model.G);
+  if (model.g > 0) {
+    printf (", g = %.3e s (so o <= g)", model.g);
+  }
+  printf ("\n");
+
+  predict_mandelbrot (&model, H, W, P, tp);
+  predict_sort (&model, N, P);
+  return 0;
+}
+
+/* eof */
@@ -1,40 +1,198 @@
 /**
  *  \file pingpong.c
- *  \brief Driver file for Homework 2: MPI ping-pong microbenchmark
+ *  \brief Driver file for Homework 2: MPI point-to-point microbenchmarks
+ *
+ *  For each power-of-two message size this measures, between ranks 0
+ *  and 1:
+ *
+ *    - one-way latency: half of a blocking MPI_Send/MPI_Recv round trip,
+ *    - the same round trip with MPI_Ssend, which forces the rendezvous
+ *      handshake that small eager sends skip,
+ *    - unidirectional bandwidth: a window of MPI_Isend/MPI_Irecv pairs
+ *      streamed one way and closed by a zero-byte acknowledgement,
+ *    - bidirectional bandwidth: both ranks streaming a window at once.
+ *
+ *  Every size and mode gets untimed warm-up rounds, then as many timed
+ *  trials as fit in a time budget (within fixed bounds), and reports
+ *  percentiles of the per-trial times rather than their mean, since a
+ *  few descheduled trials would otherwise dominate.
+ *
+ *  results.dat starts with the message size and the median one-way
+ *  latency, so netplot.gnu plots it as before; the other columns follow
+ *  and are described by the '#' header line.
  */
 
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <mpi.h>
 
 #define MIN_BUFLEN 1 /*!< Smallest message length to try, in words */
 #define MAX_BUFLEN (1 << 21) /*!< Largest message length to try, in words */
-#define NUM_TRIALS 1000 /*!< Number of timing trials */
+#define MIN_TRIALS 10 /*!< Fewest timing trials per size and mode */
+#define MAX_TRIALS 1000 /*!< Most timing trials per size and mode */
+#define WARMUP_TRIALS 5 /*!< Untimed rounds before each measurement */
+#define TRIAL_BUDGET 0.25 /*!< Seconds to spend timing each size and mode */
+#define WINDOW 64 /*!< Messages in flight in the bandwidth modes */
+#define WINDOW_BYTES (32 << 20) /*!< Cap on the bytes a window may hold */
+
+#define MSG_PING 1
+#define MSG_PONG 2
+#define MSG_DATA 3
+#define MSG_ACK 4
+
+/** Benchmark modes; each is one timed round of its kind. */
+enum {
+  MODE_PINGPONG,  /*!< Blocking send and receive, there and back */
+  MODE_SSEND,     /*!< As MODE_PINGPONG with synchronous sends */
+  MODE_UNI,       /*!< A window of messages from 0 to 1, then an ack */
+  MODE_BIDIR,     /*!< Windows in both directions at once */
+  NUM_MODES
+};
 
 /**
  *  Performs a ping-pong exchange.
  *
  *  \param msgbuf  Message data buffer to use during the volley.
  *  \param len   Length of msgbuf.
+ *  \param sync  Whether to use MPI_Ssend instead of MPI_Send.
  */
-void pingpong (int* msgbuf, const int len)
+void pingpong (int* msgbuf, const int len, const int sync)
 {
-  const int MSG_PING = 1;
-  const int MSG_PONG = 2;
-
   int rank;
   MPI_Comm_rank (MPI_COMM_WORLD, &rank);
 
   if (rank == 0) {
     MPI_Status stat;
-    MPI_Send (msgbuf, len, MPI_INT, 1, MSG_PING, MPI_COMM_WORLD);
+    if (sync) {
+      MPI_Ssend (msgbuf, len, MPI_INT, 1, MSG_PING, MPI_COMM_WORLD);
+    } else {
+      MPI_Send (msgbuf, len, MPI_INT, 1, MSG_PING, MPI_COMM_WORLD);
+    }
     MPI_Recv (msgbuf, len, MPI_INT, 1, MSG_PONG, MPI_COMM_WORLD, &stat);
   } else {
     MPI_Status stat;
     MPI_Recv (msgbuf, len, MPI_INT, 0, MSG_PING, MPI_COMM_WORLD, &stat);
-    MPI_Send (msgbuf, len, MPI_INT, 0, MSG_PONG, MPI_COMM_WORLD);
+    if (sync) {
+      MPI_Ssend (msgbuf, len, MPI_INT, 0, MSG_PONG, MPI_COMM_WORLD);
+    } else {
+      MPI_Send (msgbuf, len, MPI_INT, 0, MSG_PONG, MPI_COMM_WORLD);
+    }
+  }
+}
+
+/**
+ *  Streams a window of messages with non-blocking calls.
+ *
+ *  \param sendbuf  Data to send; every message reads the same words.
+ *  \param recvbuf  Room for 'window' messages side by side.
+ *  \param len  Length of each message, in words.
+ *  \param window  Number of messages in flight.
+ *  \param bidir  Whether both ranks send (else rank 0 sends, rank 1
+ *                receives and acknowledges the whole window).
+ */
+void stream (int* sendbuf, int* recvbuf, const int len, const int window,
+             const int bidir)
+{
+  MPI_Request reqs[2 * WINDOW];
+  int rank, peer, k, n = 0;
+  MPI_Comm_rank (MPI_COMM_WORLD, &rank);
+  peer = 1 - rank;
+
+  if (bidir || rank == 1) {
+    for (k = 0; k < window; ++k) {
+      MPI_Irecv (recvbuf + (long)k * len, len, MPI_INT, peer, MSG_DATA,
+                 MPI_COMM_WORLD, &reqs[n++]);
+    }
+  }
+  if (bidir || rank == 0) {
+    for (k = 0; k < window; ++k) {
+      MPI_Isend (sendbuf, len, MPI_INT, peer, MSG_DATA, MPI_COMM_WORLD,
+                 &reqs[n++]);
+    }
+  }
+  MPI_Waitall (n, reqs, MPI_STATUSES_IGNORE);
+
+  /* The sender only knows the data arrived once the receiver says so */
+  if (!bidir) {
+    if (rank == 1) {
+      MPI_Send (NULL, 0, MPI_BYTE, 0, MSG_ACK, MPI_COMM_WORLD);
+    } else {
+      MPI_Recv (NULL, 0, MPI_BYTE, 1, MSG_ACK, MPI_COMM_WORLD,
+                MPI_STATUS_IGNORE);
+    }
+  }
+}
+
+/** Messages per window for 'len'-word messages. */
+int window_for (const int len)
+{
+  long fit = WINDOW_BYTES / ((long)len * sizeof (int));
+  return fit < 1 ? 1 : (fit < WINDOW ? (int)fit : WINDOW);
+}
+
+/** Runs one round of 'mode' on 'len'-word messages. */
+void run_mode (const int mode, int* sendbuf, int* recvbuf, const int len)
+{
+  switch (mode) {
+  case MODE_PINGPONG: pingpong (sendbuf, len, 0); break;
+  case MODE_SSEND: pingpong (sendbuf, len, 1); break;
+  case MODE_UNI: stream (sendbuf, recvbuf, len, window_for (len), 0); break;
+  case MODE_BIDIR: stream (sendbuf, recvbuf, len, window_for (len), 1); break;
+  default: assert (0);
+  }
+}
+
+/** For qsort(). */
+int compare_doubles (const void* a, const void* b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/** The p-th percentile (0 <= p <= 100) of sorted[0:n-1], by nearest rank. */
+double percentile (const double* sorted, const int n, const double p)
+{
+  int k = (int)(p / 100 * n + 0.5);
+  if (k < 1) k = 1;
+  if (k > n) k = n;
+  return sorted[k - 1];
+}
+
+/**
+ *  Times 'mode' on 'len'-word messages: warms up, picks the trial count
+ *  from the warm-up speed, and times each trial separately.
+ *
+ *  \param times  Room for MAX_TRIALS times; sorted on return (rank 0).
+ *  \returns The number of trials.
+ */
+int measure (const int mode, int* sendbuf, int* recvbuf, const int len,
+             double* times)
+{
+  int trial, trials;
+  double t_start;
+
+  MPI_Barrier (MPI_COMM_WORLD); /* Synchronize the nodes */
+  t_start = MPI_Wtime ();
+  for (trial = 0; trial < WARMUP_TRIALS; ++trial) {
+    run_mode (mode, sendbuf, recvbuf, len);
   }
+
+  /* Rank 0 decides how many trials fit the budget and tells rank 1 */
+  trials = (int)(TRIAL_BUDGET / ((MPI_Wtime () - t_start) / WARMUP_TRIALS));
+  if (trials < MIN_TRIALS) trials = MIN_TRIALS;
+  if (trials > MAX_TRIALS) trials = MAX_TRIALS;
+  MPI_Bcast (&trials, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  for (trial = 0; trial < trials; ++trial) {
+    t_start = MPI_Wtime (); /* Start timer */
+    run_mode (mode, sendbuf, recvbuf, len);
+    times[trial] = MPI_Wtime () - t_start; /* Stop timer */
+  } /* trial */
+
+  qsort (times, trials, sizeof (double), compare_doubles);
+  return trials;
 }
 
 /** Program start */
@@ -48,6 +206,8 @@ int main (int argc, char *argv[])
   FILE *fp = NULL; /* output file, only valid on rank 0 */
 
   int* msgbuf = NULL;
+  int* recvbuf = NULL;
+  double* times = NULL;
   int len = 0;
 
   MPI_Init (&argc, &argv);	/* starts MPI */
@@ -63,35 +223,68 @@ int main (int argc, char *argv[])
   if (rank == 0) {
     fp = fopen("results.dat", "w");
     assert (fp != NULL);
+    fprintf (fp, "# bytes\tlatency_p50\tlatency_min\tlatency_p90\tlatency_p99"
+             "\tssend_p50\tuni_MBps\tbidir_MBps\ttrials\n");
+    printf ("%10s %12s %12s %12s %12s %12s %10s %10s\n", "bytes", "lat p50",
+            "lat min", "lat p90", "lat p99", "ssend p50", "uni MB/s",
+            "bidir MB/s");
   }
 
-  /* Create a buffer large enough to hold the largest message */
+  /* Create buffers large enough to hold the largest message and window */
   msgbuf = (int *)malloc (MAX_BUFLEN * sizeof (int));
-  assert (msgbuf);
+  recvbuf = (int *)malloc (WINDOW_BYTES > MAX_BUFLEN * sizeof (int)
+                           ? WINDOW_BYTES : MAX_BUFLEN * sizeof (int));
+  times = (double *)malloc (MAX_TRIALS * sizeof (double));
+  assert (msgbuf && recvbuf && times);
+  memset (msgbuf, 0, MAX_BUFLEN * sizeof (int));
 
   /* Iterates over power-of-two message sizes */
-  for (len = 1; len <= MAX_BUFLEN; len *= 2) {
-    int trial;
-    double t_start, t_elapsed;
+  for (len = MIN_BUFLEN; len <= MAX_BUFLEN; len *= 2) {
+    int num_bytes = len * sizeof (int);
+    double window_bytes = (double)window_for (len) * num_bytes;
+    double lat[4] = { 0, 0, 0, 0 }, ssend = 0, uni = 0, bidir = 0;
+    int trials, mode, latency_trials = 0;
+
+    for (mode = 0; mode < NUM_MODES; ++mode) {
+      trials = measure (mode, msgbuf, recvbuf, len, times);
+      if (rank != 0) {
+        continue;
+      }
+      /* Round trips count twice; bandwidth uses the median window time */
+      switch (mode) {
+      case MODE_PINGPONG:
+        lat[0] = percentile (times, trials, 50) / 2;
+        lat[1] = times[0] / 2;
+        lat[2] = percentile (times, trials, 90) / 2;
+        lat[3] = percentile (times, trials, 99) / 2;
+        latency_trials = trials;
+        break;
+      case MODE_SSEND:
+        ssend = percentile (times, trials, 50) / 2;
+        break;
+      case MODE_UNI:
+        uni = window_bytes / percentile (times, trials, 50) / 1e6;
+        break;
+      case MODE_BIDIR:
+        bidir = 2 * window_bytes / percentile (times, trials, 50) / 1e6;
+        break;
+      }
+    }
 
-    /* Main timing loop */
-    MPI_Barrier (MPI_COMM_WORLD); /* Synchronize the nodes */
-    t_start = MPI_Wtime (); /* Start timer */
-    for (trial = 0; trial < NUM_TRIALS; ++trial) {
-      pingpong (msgbuf, len);
-    } /* trial */
-    t_elapsed = MPI_Wtime () - t_start; /* Stop timer */
-	
     if (rank == 0) {
       /* Write the one-way transfer time data to results.dat */
-      int num_bytes = len * sizeof (int);
-      double t_msg = t_elapsed / NUM_TRIALS / 2;
-      fprintf (fp, "%d\t%.10f\n", num_bytes, t_msg);
+      fprintf (fp, "%d\t%.10f\t%.10f\t%.10f\t%.10f\t%.10f\t%.3f\t%.3f\t%d\n",
+               num_bytes, lat[0], lat[1], lat[2], lat[3], ssend, uni, bidir,
+               latency_trials);
       fflush (fp);
+      printf ("%10d %12.3e %12.3e %12.3e %12.3e %12.3e %10.1f %10.1f\n",
+              num_bytes, lat[0], lat[1], lat[2], lat[3], ssend, uni, bidir);
     }
   } /* len */
 
   free (msgbuf);
+  free (recvbuf);
+  free (times);
 
   if (rank == 0) {
     fclose (fp); /* Close results.dat */
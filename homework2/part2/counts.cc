@@ -0,0 +1,44 @@
+/**
+ *  \file counts.cc
+ *
+ *  \brief Run-length coding of iteration-count rows. See 'counts.hh'.
+ */
+
+#include <cassert>
+#include <cstdlib>
+
+#include "counts.hh"
+
+int rle_encode (const count_t* in, int n, count_t* out, int max_out) {
+  int len = 0;
+  int j = 0;
+  while (j < n) {
+    count_t v = in[j];
+    int run = 1;
+    while (j + run < n && run < RLE_MAX_RUN && in[j + run] == v) {
+      ++run;
+    }
+    if (len + 2 > max_out) {
+      return -1;
+    }
+    out[len++] = (count_t)run;
+    out[len++] = v;
+    j += run;
+  }
+  return len;
+}
+
+void rle_decode (const count_t* in, int len, count_t* out, int n) {
+  assert (len % 2 == 0);
+  int j = 0;
+  for (int k = 0; k < len; k += 2) {
+    int run = in[k];
+    assert (j + run <= n);
+    for (int r = 0; r < run; ++r) {
+      out[j++] = in[k + 1];
+    }
+  }
+  assert (j == n);
+}
+
+/* eof */
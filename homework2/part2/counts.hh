@@ -0,0 +1,31 @@
+#if !defined (INC_COUNTS_HH)
+#define INC_COUNTS_HH
+
+#include <stdint.h>
+
+/** Escape-time iteration counts; maxit is far below 65536, so 16 bits do. */
+typedef uint16_t count_t;
+
+/** MPI datatype matching 'count_t'. */
+#define MPI_COUNT_T MPI_UNSIGNED_SHORT
+
+/** Largest run a single (length, value) pair can describe. */
+#define RLE_MAX_RUN 0xffff
+
+/**
+ *  Run-length encodes in[0:n-1] into 'out' as (length, value) pairs and
+ *  returns the number of count_t words written. Gives up and returns -1
+ *  as soon as the encoding would need more than 'max_out' words, so the
+ *  caller can fall back to sending the counts raw.
+ */
+int rle_encode (const count_t* in, int n, count_t* out, int max_out);
+
+/**
+ *  Expands 'len' words of (length, value) pairs from 'in' into
+ *  out[0:n-1]. Aborts if the pairs do not describe exactly n counts.
+ */
+void rle_decode (const count_t* in, int len, count_t* out, int n);
+
+#endif
+
+/* eof */
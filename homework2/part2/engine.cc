@@ -0,0 +1,612 @@
+/**
+ *  \file engine.cc
+ *
+ *  \brief Mandelbrot engine with pluggable row decompositions. See
+ *  'engine.hh'.
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <mpi.h>
+
+#include "timer.c"
+#include "engine.hh"
+#include "farm.hh"
+#include "kernel.hh"
+#include "mariani.hh"
+#include "output.hh"
+#include "profile.hh"
+#include "rawio.hh"
+#include "zoom.hh"
+
+static const char* strategy_names[NUM_STRATEGIES] = {
+  "block", "cyclic", "blockcyclic", "dynamic", "steal"
+};
+
+static const char* strategy_logic[NUM_STRATEGIES] = {
+  "Joe Block's Logic", "Susie Cyclic's Logic", "Block-Cyclic Logic",
+  "Master Slave Logic", "Work Stealing Logic"
+};
+
+/** Everything a strategy needs to render the frames. */
+struct run_t {
+  kernel_t base;      /*!< Kernel settings; frames derive theirs from it */
+  zoom_t zoom;
+  strategy_t strategy;
+  int chunk;          /*!< Rows per chunk for block-cyclic and dynamic */
+  int depth;          /*!< Dynamic: chunks queued per rank */
+  int height, width;
+  int rank, np;
+  int format;         /*!< FORMAT_PNG, or a raw format written through MPI-IO */
+  int samples;        /*!< NxN supersampling of edge pixels, for PNG */
+  const char* name;   /*!< Names the output files */
+  profile_t prof;
+  output_t out;       /*!< Only used on rank 0, for PNG */
+};
+
+/**
+ *  Removes '-s <strategy>' and '-b <rows>' from argv[1:argc-1] and
+ *  returns the number of arguments left; 0 if a value is bad.
+ */
+static int
+strategy_parse (int argc, char* argv[], strategy_t* s, int* chunk, int* depth) {
+  int kept = 1;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp (argv[i], "-s") == 0 && i + 1 < argc) {
+      ++i;
+      int n = 0;
+      while (n < NUM_STRATEGIES && strcmp (argv[i], strategy_names[n]) != 0) {
+        ++n;
+      }
+      if (n == NUM_STRATEGIES) {
+        return 0;
+      }
+      *s = (strategy_t)n;
+    } else if (strcmp (argv[i], "-b") == 0 && i + 1 < argc) {
+      *chunk = atoi (argv[++i]);
+      if (*chunk <= 0) {
+        return 0;
+      }
+    } else if (strcmp (argv[i], "-q") == 0 && i + 1 < argc) {
+      *depth = atoi (argv[++i]);
+      if (*depth <= 0) {
+        return 0;
+      }
+    } else {
+      argv[kept++] = argv[i];
+    }
+  }
+  return kept;
+}
+
+void engine_usage (const char* prog) {
+  kernel_usage (prog);
+  fprintf (stderr, "-s <strategy> spreads rows over the ranks: block, cyclic, blockcyclic\n");
+  fprintf (stderr, "   or dynamic (rank 0 hands out chunks and computes when idle),\n");
+  fprintf (stderr, "   or steal (ranks take chunks from a counter in an MPI window),\n");
+  fprintf (stderr, "-b <rows> sets the chunk for blockcyclic (default 16), dynamic and steal (1),\n");
+  fprintf (stderr, "-q <chunks> keeps that many chunks queued per rank in dynamic (default 2),\n");
+  fprintf (stderr, "-f <frames> renders a zoom sequence about the centre with one launch,\n");
+  fprintf (stderr, "-k <factor> zooming by <factor> per frame (default 2),\n");
+  fprintf (stderr, "-a <N> anti-aliases PNGs with NxN samples in pixels on an edge,\n");
+  fprintf (stderr, "-o <format> writes png (default), or pgm (16-bit greyscale counts) or\n");
+  fprintf (stderr, "   raw (bare counts) with every rank writing its own rows; under dynamic\n");
+  fprintf (stderr, "   rank 0 writes whole frames, since it assembles them anyway, and\n");
+  fprintf (stderr, "-t <file> appends per-rank timings to a CSV file.\n");
+}
+
+/**
+ *  Computes rows [row0, row1) of frame f into out. Pixels the previous
+ *  frame already has repeat their left neighbour (keeping run-length
+ *  coding tight) and are filled in on rank 0 by zoom_fill().
+ */
+static void
+compute_rows (run_t* run, const kernel_t* k, int f, int row0, int row1,
+              count_t* out) {
+  int width = run->width;
+  if (k->subdivide) {
+    mariani_silver (k, width, row0, row1, out);
+    return;
+  }
+  for (int i = row0; i < row1; ++i) {
+    count_t* row = out + (long)(i - row0)*width;
+    for (int j = 0; j < width; ++j) {
+      if (zoom_reused (&run->zoom, f, i, j)) {
+        row[j] = j > 0 ? row[j - 1] : 0;
+      } else {
+        row[j] = mandelbrot_pixel (k, i, j);
+      }
+    }
+  }
+}
+
+/**
+ *  Collective over 'comm': writes this rank's chunks of frame f (see
+ *  rawio_write()) to the frame's raw file.
+ */
+static void
+write_raw (run_t* run, MPI_Comm comm, int f, const count_t* local, int chunks,
+           const int* first, const int* rows) {
+  char filename[128];
+  output_filename (filename, run->name, run->np, run->height, run->width,
+                   run->zoom.frames, f, format_ext[run->format]);
+  rawio_t raw;
+  rawio_open (&raw, comm, filename, run->format, run->height, run->width,
+              kernel_max_count (&run->base));
+  rawio_write (&raw, local, chunks, first, rows);
+  rawio_close (&raw);
+  profile_add (&run->prof, PROF_ENCODE);
+}
+
+/* =================================================== */
+/*
+ * Static strategies: every rank knows its rows up front
+ */
+
+/** Number of chunks the rows are cut into; chunk c belongs to rank c%np. */
+static int
+num_chunks (const run_t* run) {
+  if (run->strategy == STRATEGY_BLOCK) {
+    return run->np;
+  }
+  return (run->height + run->chunk - 1)/run->chunk;
+}
+
+/** Rows [*first, *last) of chunk c. */
+static void
+chunk_rows (const run_t* run, int c, int* first, int* last) {
+  if (run->strategy == STRATEGY_BLOCK) {
+    *first = (int)((long)c*run->height/run->np);
+    *last = (int)((long)(c + 1)*run->height/run->np);
+  } else {
+    *first = c*run->chunk;
+    *last = *first + run->chunk < run->height ? *first + run->chunk : run->height;
+  }
+}
+
+/** Number of rows rank r owns. */
+static int
+rows_owned (const run_t* run, int r) {
+  int rows = 0;
+  for (int c = r; c < num_chunks (run); c += run->np) {
+    int first, last;
+    chunk_rows (run, c, &first, &last);
+    rows += last - first;
+  }
+  return rows;
+}
+
+static void
+run_static (run_t* run) {
+  int height = run->height, width = run->width;
+  int rank = run->rank, np = run->np;
+  int local_rows = rows_owned (run, rank);
+  count_t *local = new count_t[(long)local_rows*width];
+
+  //Raw output: this rank's chunks, as rawio_write() takes them
+  int owned = 0;
+  int *firsts = new int[num_chunks (run)/np + 1];
+  int *rows = new int[num_chunks (run)/np + 1];
+  for (int c = rank; c < num_chunks (run); c += np, ++owned) {
+    int last;
+    chunk_rows (run, c, &firsts[owned], &last);
+    rows[owned] = last - firsts[owned];
+  }
+
+  //PNG: rank 0 keeps the last frame for reuse and gathers into a second buffer
+  count_t *counts[2] = { NULL, NULL };
+  count_t *gathered = NULL;
+  int *recvcounts = NULL, *displs = NULL;
+  if (rank == 0 && run->format == FORMAT_PNG) {
+    counts[0] = new count_t[(long)width*height];
+    counts[1] = run->zoom.frames > 1 ? new count_t[(long)width*height] : NULL;
+    gathered = run->strategy == STRATEGY_BLOCK ? NULL : new count_t[(long)width*height];
+    recvcounts = new int[np];
+    displs = new int[np];
+    for (int r = 0, offset = 0; r < np; ++r) {
+      recvcounts[r] = rows_owned (run, r)*width;
+      displs[r] = offset;
+      offset += recvcounts[r];
+    }
+  }
+
+  for (int f = 0; f < run->zoom.frames; ++f) {
+    kernel_t k;
+    zoom_frame (&run->zoom, &run->base, f, height, width, &k);
+    profile_mark (&run->prof);
+    count_t *at = local;
+    for (int c = rank; c < num_chunks (run); c += np) {
+      int first, last;
+      chunk_rows (run, c, &first, &last);
+      compute_rows (run, &k, f, first, last, at);
+      at += (long)(last - first)*width;
+    }
+    kernel_free (&k);
+    run->prof.rows += local_rows;
+    profile_add (&run->prof, PROF_COMPUTE);
+
+    //The barrier separates waiting for the slowest rank from the transfer
+    MPI_Barrier (MPI_COMM_WORLD);
+    profile_add (&run->prof, PROF_WAIT);
+    if (run->format != FORMAT_PNG) {
+      write_raw (run, MPI_COMM_WORLD, f, local, owned, firsts, rows);
+      continue;
+    }
+    //Blocks arrive in image order; other layouts are put in place below
+    count_t *frame = rank == 0 ? counts[f%2] : NULL;
+    MPI_Gatherv (local, local_rows*width, MPI_COUNT_T,
+                 gathered ? gathered : frame, recvcounts, displs, MPI_COUNT_T,
+                 0, MPI_COMM_WORLD);
+    if (rank != 0) {
+      run->prof.bytes += (double)local_rows*width*sizeof (count_t);
+    }
+    if (gathered) {
+      count_t *from = gathered;
+      for (int r = 0; r < np; ++r) {
+        for (int c = r; c < num_chunks (run); c += np) {
+          int first, last;
+          chunk_rows (run, c, &first, &last);
+          memcpy (frame + (long)first*width, from,
+                  (long)(last - first)*width*sizeof (count_t));
+          from += (long)(last - first)*width;
+        }
+      }
+    }
+    profile_add (&run->prof, PROF_COMM);
+
+    if (rank == 0) {
+      if (f > 0) {
+        zoom_fill (&run->zoom, counts[(f - 1)%2], frame, height, width);
+      }
+      output_frame (&run->out, frame, f, &run->prof);
+    }
+  }
+
+  delete[] local;
+  delete[] counts[0];
+  delete[] counts[1];
+  delete[] gathered;
+  delete[] recvcounts;
+  delete[] displs;
+  delete[] firsts;
+  delete[] rows;
+}
+
+/* =================================================== */
+/*
+ * Dynamic strategy: a task farm hands out chunks of rows as ranks finish
+ */
+
+/**
+ *  Farm client: task t is chunk t%per_frame of frame t/per_frame, and a
+ *  result is a flag word (RLE-coded or raw) followed by the chunk.
+ */
+struct chunk_farm_t {
+  typedef int task_t;
+  typedef count_t result_t;
+
+  run_t* run;
+  int per_frame, total;
+  int task, finished;   /*!< Next task to hand out; frames written so far */
+  count_t* counts[3];   /*!< Rank 0: frames f-1 (for reuse), f and f+1 */
+  count_t* scratch;     /*!< One chunk of counts before encoding */
+  int* received;        /*!< Rows of each frame that have come back */
+  kernel_t k;           /*!< Kernel of the frame last worked on */
+  int current_frame;
+
+  /** Rows of task t start at *first. */
+  int rows (int t, int* first) const {
+    *first = (t%per_frame)*run->chunk;
+    return *first + run->chunk < run->height ? run->chunk : run->height - *first;
+  }
+
+  //Chunks of frame f+2 wait until frame f is written
+  int next (int* t) {
+    if (task == total) {
+      return FARM_DONE;
+    }
+    if (task/per_frame >= finished + 2) {
+      return FARM_WAIT;
+    }
+    *t = task++;
+    return FARM_TASK;
+  }
+
+  int work (const int& t, count_t* result) {
+    int f = t/per_frame, first;
+    int n = rows (t, &first)*run->width;
+    if (f != current_frame) {
+      if (current_frame >= 0) {
+        kernel_free (&k);
+      }
+      zoom_frame (&run->zoom, &run->base, f, run->height, run->width, &k);
+      current_frame = f;
+    }
+    count_t *values = scratch;
+    compute_rows (run, &k, f, first, first + n/run->width, values);
+    run->prof.rows += n/run->width;
+
+    //Interior and exterior runs compress well; send raw when they don't
+    int len = rle_encode (values, n, result + 1, n);
+    if (len >= 0) {
+      result[0] = 1;
+      return len + 1;
+    }
+    result[0] = 0;
+    memcpy (result + 1, values, n*sizeof (count_t));
+    return n + 1;
+  }
+
+  void done (const int& t, const count_t* result, int len) {
+    int f = t/per_frame, first;
+    int n = rows (t, &first)*run->width;
+    count_t *dest = counts[f%3] + (long)first*run->width;
+    if (result[0]) {
+      rle_decode (result + 1, len - 1, dest, n);
+    } else {
+      memcpy (dest, result + 1, n*sizeof (count_t));
+    }
+    received[f] += n/run->width;
+
+    //Write frames in order as they complete
+    while (finished < run->zoom.frames && received[finished] == run->height) {
+      int g = finished++;
+      if (g > 0) {
+        zoom_fill (&run->zoom, counts[(g - 1)%3], counts[g%3], run->height,
+                   run->width);
+      }
+      if (run->format == FORMAT_PNG) {
+        output_frame (&run->out, counts[g%3], g, &run->prof);
+      } else {
+        //Only rank 0 runs done(), so the farm cannot use the collective
+        //write: the frame goes out from here, whole, over MPI_COMM_SELF
+        int first = 0;
+        write_raw (run, MPI_COMM_SELF, g, counts[g%3], 1, &first, &run->height);
+      }
+    }
+  }
+};
+
+static void
+run_dynamic (run_t* run) {
+  int height = run->height, width = run->width;
+  chunk_farm_t client;
+  client.run = run;
+  client.per_frame = (height + run->chunk - 1)/run->chunk;
+  client.total = run->zoom.frames*client.per_frame;
+  client.task = client.finished = 0;
+  client.current_frame = -1;
+  client.received = NULL;
+  client.counts[0] = client.counts[1] = client.counts[2] = NULL;
+  client.scratch = new count_t[(long)run->chunk*width];
+  if (run->rank == 0) {
+    for (int b = 0; b < 3; b++) {
+      client.counts[b] = new count_t[(long)width*height];
+    }
+    client.received = new int[run->zoom.frames]();
+  }
+
+  farm_t farm;
+  farm_init<chunk_farm_t> (&farm, MPI_COMM_WORLD, run->chunk*width + 1, run->depth);
+  farm.prof = &run->prof;
+  farm_run (&farm, &client);
+  farm_free (&farm);
+
+  if (client.current_frame >= 0) {
+    kernel_free (&client.k);
+  }
+  delete[] client.counts[0];
+  delete[] client.counts[1];
+  delete[] client.counts[2];
+  delete[] client.scratch;
+  delete[] client.received;
+}
+
+/* =================================================== */
+/*
+ * Work stealing: no master, ranks take chunks from a counter on rank 0
+ * and put their counts straight into rank 0's frame buffers, or keep
+ * them for a collective raw write
+ */
+
+static void
+run_steal (run_t* run) {
+  int height = run->height, width = run->width;
+  int rank = run->rank, chunk = run->chunk;
+  const int per_frame = (height + chunk - 1)/chunk;
+  const int one = 1;
+  const bool raw = run->format != FORMAT_PNG;
+
+  //Rank 0 holds one counter per frame and three frames of counts: f-1
+  //for reuse, f being written out and f+1 being filled by the others
+  int *next = NULL;
+  count_t *counts = NULL;
+  long frame_size = (long)width*height;
+  MPI_Win counter_win, counts_win;
+  MPI_Win_allocate (rank == 0 ? run->zoom.frames*sizeof (int) : 0, sizeof (int),
+                    MPI_INFO_NULL, MPI_COMM_WORLD, &next, &counter_win);
+  MPI_Win_allocate (rank == 0 && !raw ? 3*frame_size*sizeof (count_t) : 0,
+                    sizeof (count_t), MPI_INFO_NULL, MPI_COMM_WORLD, &counts,
+                    &counts_win);
+  if (rank == 0) {
+    memset (next, 0, run->zoom.frames*sizeof (int));
+  }
+  MPI_Barrier (MPI_COMM_WORLD);
+  MPI_Win_lock_all (0, counter_win);
+  MPI_Win_lock_all (0, counts_win);
+  count_t *values = new count_t[(long)chunk*width];
+  //Raw output: the chunks this rank took in the current frame
+  std::vector<count_t> kept;
+  std::vector<int> firsts, kept_rows;
+  profile_add (&run->prof, PROF_COMM);
+
+  for (int f = 0; f < run->zoom.frames; ++f) {
+    kernel_t k;
+    zoom_frame (&run->zoom, &run->base, f, height, width, &k);
+    while (true) {
+      int c = 0;
+      MPI_Fetch_and_op (&one, &c, MPI_INT, 0, f, MPI_SUM, counter_win);
+      MPI_Win_flush (0, counter_win);
+      if (c >= per_frame) {
+        break;
+      }
+      int first = c*chunk;
+      int rows = first + chunk < height ? chunk : height - first;
+      if (raw) {
+        profile_add (&run->prof, PROF_COMM);
+        kept.resize (kept.size () + (long)rows*width);
+        compute_rows (run, &k, f, first, first + rows,
+                      kept.data () + kept.size () - (long)rows*width);
+        firsts.push_back (first);
+        kept_rows.push_back (rows);
+        run->prof.rows += rows;
+        profile_add (&run->prof, PROF_COMPUTE);
+        continue;
+      }
+      //The last put from 'values' must be done before it is overwritten
+      MPI_Win_flush_local (0, counts_win);
+      profile_add (&run->prof, PROF_COMM);
+      compute_rows (run, &k, f, first, first + rows, values);
+      run->prof.rows += rows;
+      profile_add (&run->prof, PROF_COMPUTE);
+      MPI_Put (values, rows*width, MPI_COUNT_T, 0,
+               (f%3)*frame_size + (long)first*width, rows*width, MPI_COUNT_T,
+               counts_win);
+      run->prof.bytes += (double)rows*width*sizeof (count_t);
+    }
+    kernel_free (&k);
+    if (raw) {
+      profile_add (&run->prof, PROF_COMM);
+      write_raw (run, MPI_COMM_WORLD, f, kept.data (), firsts.size (),
+                 firsts.data (), kept_rows.data ());
+      kept.clear ();
+      firsts.clear ();
+      kept_rows.clear ();
+      continue;
+    }
+
+    //Every chunk of the frame has landed once all ranks are past here
+    MPI_Win_flush (0, counts_win);
+    profile_add (&run->prof, PROF_COMM);
+    MPI_Barrier (MPI_COMM_WORLD);
+    profile_add (&run->prof, PROF_WAIT);
+    if (rank == 0) {
+      MPI_Win_sync (counts_win);
+      count_t *frame = counts + (f%3)*frame_size;
+      if (f > 0) {
+        zoom_fill (&run->zoom, counts + ((f - 1)%3)*frame_size, frame, height,
+                   width);
+      }
+      output_frame (&run->out, frame, f, &run->prof);
+    }
+  }
+
+  MPI_Win_unlock_all (counts_win);
+  MPI_Win_unlock_all (counter_win);
+  MPI_Win_free (&counts_win);
+  MPI_Win_free (&counter_win);
+  delete[] values;
+  profile_add (&run->prof, PROF_COMM);
+}
+
+/* =================================================== */
+
+int mandelbrot_main (int argc, char* argv[], const char* name,
+                     strategy_t strategy) {
+  struct stopwatch_t* timer;
+  timer = stopwatch_create ();
+  stopwatch_init ();
+  stopwatch_start (timer);
+
+  //MPI Initialization
+  run_t run;
+  MPI_Init (&argc, &argv);	/* starts MPI */
+  MPI_Comm_rank (MPI_COMM_WORLD, &run.rank);	/* Get process id */
+  MPI_Comm_size (MPI_COMM_WORLD, &run.np);	/* Get number of processes */
+  profile_init (&run.prof);
+
+  const char *csv = NULL;
+  run.base = kernel_default ();
+  run.zoom = zoom_default ();
+  run.strategy = strategy;
+  run.chunk = 0;
+  run.depth = 2;
+  run.format = FORMAT_PNG;
+  run.samples = 1;
+  argc = profile_parse (argc, argv, &csv);
+  argc = argc ? zoom_parse (argc, argv, &run.zoom) : 0;
+  argc = argc ? strategy_parse (argc, argv, &run.strategy, &run.chunk, &run.depth) : 0;
+  argc = argc ? rawio_parse (argc, argv, &run.format) : 0;
+  argc = argc ? output_parse (argc, argv, &run.samples) : 0;
+  argc = argc ? kernel_parse (argc, argv, &run.base) : 0;
+  if (argc != 3 || atoi (argv[1]) <= 0 || atoi (argv[2]) <= 0) {
+    if (run.rank == 0) {
+      engine_usage (argv[0]);
+    }
+    MPI_Finalize ();
+    return -1;
+  }
+  run.height = atoi (argv[1]);
+  run.width = atoi (argv[2]);
+
+  if (run.strategy == STRATEGY_CYCLIC) {
+    run.chunk = 1;
+  } else if (run.chunk == 0) {
+    run.chunk = run.strategy == STRATEGY_BLOCK_CYCLIC ? 16 : 1;
+  }
+  if (name == NULL) {
+    name = strategy_names[run.strategy];
+  }
+  run.name = name;
+  if (run.rank == 0) {
+    if (run.np == 1) {
+      printf("Mandelbrot Image Generation Serially started!\n");
+    } else {
+      printf("Mandelbrot Image Generation using %s started!\n", strategy_logic[run.strategy]);
+    }
+  }
+
+  zoom_init (&run.zoom, run.height, run.width);
+  //Raw output never brings a whole frame together, except under the
+  //farm, so pixels can only be reused from the last frame there
+  if (run.format != FORMAT_PNG && run.strategy != STRATEGY_DYNAMIC) {
+    run.zoom.q = 0;
+  }
+  if (run.rank == 0 && run.format == FORMAT_PNG) {
+    output_init (&run.out, name, run.np, run.height, run.width, &run.base,
+                 &run.zoom, run.samples);
+  }
+  profile_mark (&run.prof);
+
+  if (run.strategy == STRATEGY_DYNAMIC) {
+    run_dynamic (&run);
+  } else if (run.strategy == STRATEGY_STEAL) {
+    run_steal (&run);
+  } else {
+    run_static (&run);
+  }
+
+  if (run.rank == 0 && run.format == FORMAT_PNG) {
+    output_finish (&run.out, &run.prof);
+  }
+  profile_report (&run.prof, name, run.height, run.width, csv, MPI_COMM_WORLD);
+  MPI_Finalize ();
+
+  long double elap_time = stopwatch_stop (timer);
+  stopwatch_destroy (timer);
+  if (run.rank == 0) {
+    printf ("Time: %Lg seconds", elap_time);
+    printf("Generating %d image(s) of size %dx%d using %d processes (%s",
+           run.zoom.frames, run.height, run.width, run.np, strategy_names[run.strategy]);
+    if (run.strategy != STRATEGY_BLOCK) {
+      printf(", %d-row chunks", run.chunk);
+    }
+    printf(")\n");
+    printf("Mandelbrot Image Generation finished!\n\n");
+  }
+  return 0;
+}
+
+/* eof */
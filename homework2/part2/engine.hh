@@ -0,0 +1,29 @@
+#if !defined (INC_ENGINE_HH)
+#define INC_ENGINE_HH
+
+/** How image rows are spread over the ranks; see '-s' in engine_usage(). */
+enum strategy_t {
+  STRATEGY_BLOCK,        /*!< One contiguous block of rows per rank */
+  STRATEGY_CYCLIC,       /*!< Row i on rank i%np */
+  STRATEGY_BLOCK_CYCLIC, /*!< Chunks of '-b' rows dealt out round robin */
+  STRATEGY_DYNAMIC,      /*!< Rank 0 hands out chunks as ranks finish */
+  STRATEGY_STEAL,        /*!< Ranks take chunks from a shared counter themselves */
+  NUM_STRATEGIES
+};
+
+/** Prints the command line accepted by mandelbrot_main() to stderr. */
+void engine_usage (const char* prog);
+
+/**
+ *  The whole program: initializes MPI, parses the command line, renders
+ *  every frame with one shared kernel and output path, and finalizes
+ *  MPI. 'strategy' is the default for '-s'; 'name' labels the messages
+ *  and output files, or is NULL to use the strategy's name. Returns the
+ *  exit status.
+ */
+int mandelbrot_main (int argc, char* argv[], const char* name,
+                     strategy_t strategy);
+
+#endif
+
+/* eof */
@@ -0,0 +1,213 @@
+/**
+ *  \file farm.cc
+ *
+ *  \brief Dynamic MPI task farm. See 'farm.hh'.
+ */
+
+#include <cassert>
+#include <cstdlib>
+
+#include "farm.hh"
+
+/** Message tags: tasks and the stop message go out, results come back. */
+#define TAG_TASK 0
+#define TAG_STOP 1
+#define TAG_RESULT 2
+
+/** Charges the time since the last charge to 'phase', if profiling. */
+static void
+charge (farm_t* f, int phase) {
+  if (f->prof) {
+    profile_add (f->prof, phase);
+  }
+}
+
+void farm_init (farm_t* f, MPI_Comm comm, int task_bytes, int result_bytes,
+                int depth) {
+  assert (task_bytes > 0 && result_bytes > 0 && depth > 0);
+  f->comm = comm;
+  MPI_Comm_rank (comm, &f->rank);
+  MPI_Comm_size (comm, &f->np);
+  f->task_bytes = task_bytes;
+  f->result_bytes = result_bytes;
+  f->depth = depth;
+  f->master_works = true;
+  f->prof = NULL;
+  f->slots = NULL;
+  f->sends = f->recvs = NULL;
+  f->head = f->count = NULL;
+  f->results[0] = f->results[1] = MPI_REQUEST_NULL;
+  f->task = NULL;
+  f->result[0] = new char[result_bytes];
+  f->result[1] = NULL;
+
+  if (f->rank == 0) {
+    long n = (long)f->np*depth;
+    f->slots = new char[n*task_bytes];
+    f->sends = new MPI_Request[n];
+    f->head = new int[f->np]();
+    f->count = new int[f->np]();
+    f->task = new char[task_bytes];
+    for (int w = 1; w < f->np; ++w) {
+      for (int s = 0; s < depth; ++s) {
+        long k = (long)w*depth + s;
+        MPI_Send_init (f->slots + k*task_bytes, task_bytes, MPI_BYTE, w,
+                       TAG_TASK, comm, &f->sends[k]);
+      }
+    }
+  } else {
+    f->slots = new char[(long)depth*task_bytes];
+    f->recvs = new MPI_Request[depth];
+    f->result[1] = new char[result_bytes];
+    //Any tag: the stop message lands in a task slot too
+    for (int s = 0; s < depth; ++s) {
+      MPI_Recv_init (f->slots + (long)s*task_bytes, task_bytes, MPI_BYTE, 0,
+                     MPI_ANY_TAG, comm, &f->recvs[s]);
+    }
+  }
+}
+
+/** Rank 0's side of farm_run(). */
+static void
+run_master (farm_t* f, const farm_ops_t* ops, void* ctx) {
+  int depth = f->depth;
+  int pending = 0; //Tasks handed out whose results are not back yet
+  MPI_Status status;
+
+  while (true) {
+    //Top up the queues, shallowest first, while there are tasks
+    int state = FARM_TASK;
+    for (int d = 0; d < depth && state == FARM_TASK; ++d) {
+      for (int w = 1; w < f->np && state == FARM_TASK; ++w) {
+        if (f->count[w] != d) {
+          continue;
+        }
+        long k = (long)w*depth + (f->head[w] + d)%depth;
+        //The slot's last send is long over: its result has come back
+        MPI_Wait (&f->sends[k], MPI_STATUS_IGNORE);
+        state = ops->next (ctx, f->slots + k*f->task_bytes);
+        if (state == FARM_TASK) {
+          MPI_Start (&f->sends[k]);
+          ++f->count[w];
+          ++pending;
+        }
+      }
+    }
+    charge (f, PROF_COMM);
+
+    //Collect what has arrived; with nothing there, work instead of waiting
+    int arrived = 0;
+    if (pending > 0) {
+      MPI_Iprobe (MPI_ANY_SOURCE, TAG_RESULT, f->comm, &arrived, &status);
+    }
+    if (!arrived && (f->master_works || f->np == 1)) {
+      state = ops->next (ctx, f->task);
+      if (state == FARM_TASK) {
+        charge (f, PROF_COMM);
+        int bytes = ops->work (ctx, f->task, f->result[0]);
+        assert (bytes >= 0 && bytes <= f->result_bytes);
+        charge (f, PROF_COMPUTE);
+        ops->done (ctx, f->task, f->result[0], bytes);
+        charge (f, PROF_COMM);
+        continue;
+      }
+    }
+    if (!arrived) {
+      if (pending == 0) {
+        //Nothing out there could turn a FARM_WAIT into a task
+        assert (state == FARM_DONE);
+        break;
+      }
+      charge (f, PROF_COMM);
+      MPI_Probe (MPI_ANY_SOURCE, TAG_RESULT, f->comm, &status);
+      charge (f, PROF_WAIT);
+    }
+
+    //Results from a worker come back in the order its tasks went out
+    int w = status.MPI_SOURCE, bytes = 0;
+    MPI_Recv (f->result[0], f->result_bytes, MPI_BYTE, w, TAG_RESULT, f->comm,
+              &status);
+    MPI_Get_count (&status, MPI_BYTE, &bytes);
+    long k = (long)w*depth + f->head[w];
+    ops->done (ctx, f->slots + k*f->task_bytes, f->result[0], bytes);
+    f->head[w] = (f->head[w] + 1)%depth;
+    --f->count[w];
+    --pending;
+    charge (f, PROF_COMM);
+  }
+
+  for (int w = 1; w < f->np; ++w) {
+    MPI_Send (NULL, 0, MPI_BYTE, w, TAG_STOP, f->comm);
+  }
+  MPI_Waitall ((f->np - 1)*depth, f->sends + depth, MPI_STATUSES_IGNORE);
+  charge (f, PROF_COMM);
+}
+
+/** A worker's side of farm_run(). */
+static void
+run_worker (farm_t* f, const farm_ops_t* ops, void* ctx) {
+  int depth = f->depth;
+  MPI_Startall (depth, f->recvs);
+  charge (f, PROF_COMM);
+
+  //Receives were posted in slot order, so tasks arrive in slot order
+  int s = 0, r = 0;
+  while (true) {
+    MPI_Status status;
+    MPI_Wait (&f->recvs[s], &status);
+    charge (f, PROF_WAIT);
+    if (status.MPI_TAG == TAG_STOP) {
+      break;
+    }
+    //The result buffer may still be going out from two tasks ago
+    MPI_Wait (&f->results[r], MPI_STATUS_IGNORE);
+    charge (f, PROF_COMM);
+    int bytes = ops->work (ctx, f->slots + (long)s*f->task_bytes, f->result[r]);
+    assert (bytes >= 0 && bytes <= f->result_bytes);
+    charge (f, PROF_COMPUTE);
+    MPI_Isend (f->result[r], bytes, MPI_BYTE, 0, TAG_RESULT, f->comm,
+               &f->results[r]);
+    if (f->prof) {
+      f->prof->bytes += bytes;
+    }
+    MPI_Start (&f->recvs[s]);
+    s = (s + 1)%depth;
+    r = 1 - r;
+    charge (f, PROF_COMM);
+  }
+
+  //The other slots are still posted; take them down for the next run
+  for (int i = 1; i < depth; ++i) {
+    int k = (s + i)%depth;
+    MPI_Cancel (&f->recvs[k]);
+    MPI_Wait (&f->recvs[k], MPI_STATUS_IGNORE);
+  }
+  MPI_Waitall (2, f->results, MPI_STATUSES_IGNORE);
+  charge (f, PROF_COMM);
+}
+
+void farm_run (farm_t* f, const farm_ops_t* ops, void* ctx) {
+  if (f->rank == 0) {
+    run_master (f, ops, ctx);
+  } else {
+    run_worker (f, ops, ctx);
+  }
+}
+
+void farm_free (farm_t* f) {
+  int n = f->rank == 0 ? (f->np - 1)*f->depth : f->depth;
+  MPI_Request* requests = f->rank == 0 ? f->sends + f->depth : f->recvs;
+  for (int i = 0; i < n; ++i) {
+    MPI_Request_free (&requests[i]);
+  }
+  delete[] f->slots;
+  delete[] f->sends;
+  delete[] f->recvs;
+  delete[] f->head;
+  delete[] f->count;
+  delete[] f->task;
+  delete[] f->result[0];
+  delete[] f->result[1];
+}
+
+/* eof */
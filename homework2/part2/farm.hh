@@ -0,0 +1,120 @@
+#if !defined (INC_FARM_HH)
+#define INC_FARM_HH
+
+#include <mpi.h>
+
+#include "profile.hh"
+
+/**
+ *  A dynamic task farm: rank 0 hands out tasks and collects results,
+ *  and computes tasks itself whenever the other ranks are busy. Each
+ *  worker keeps up to 'depth' tasks queued, so it starts the next one
+ *  while its last result travels back. Tasks are fixed-size records;
+ *  results may be any length up to a fixed maximum.
+ *
+ *  The farm is set up once with farm_init() and may run any number of
+ *  times; the task messages use persistent requests created up front,
+ *  and every buffer is allocated by farm_init().
+ */
+
+/** What a client's next() callback reports. */
+enum {
+  FARM_TASK,  /*!< A task was written to the buffer */
+  FARM_WAIT,  /*!< Nothing to hand out until some result comes back */
+  FARM_DONE   /*!< Nothing left; keep returning this */
+};
+
+/** A client's callbacks; next() and done() only run on rank 0. */
+struct farm_ops_t {
+  /** Writes the next task to 'task' and returns FARM_TASK, or returns FARM_WAIT or FARM_DONE. */
+  int (*next) (void* ctx, void* task);
+  /** Computes 'task' into 'result' and returns the number of bytes written. */
+  int (*work) (void* ctx, const void* task, void* result);
+  /** Takes the 'bytes' long result of 'task'. Called once per task, in no particular order. */
+  void (*done) (void* ctx, const void* task, const void* result, int bytes);
+};
+
+struct farm_t {
+  MPI_Comm comm;
+  int rank, np;
+  int task_bytes, result_bytes; /*!< Task size and largest result */
+  int depth;                    /*!< Tasks queued per worker */
+  bool master_works;            /*!< Whether rank 0 also computes tasks */
+  profile_t* prof;              /*!< If not NULL, charged for the farm's time */
+
+  /* Rank 0: worker w's queue is slots head[w], head[w]+1, ... (mod depth) */
+  char* slots;                  /*!< (np-1)*depth tasks in flight */
+  MPI_Request* sends;           /*!< Persistent send for each slot */
+  int *head, *count;
+
+  /* Workers: tasks land in slots in order; results go out double buffered */
+  MPI_Request* recvs;           /*!< Persistent receive for each slot */
+  MPI_Request results[2];
+
+  char* task;                   /*!< Rank 0's own task */
+  char* result[2];              /*!< Result buffers */
+};
+
+/**
+ *  Collective over 'comm': sets up a farm for tasks of 'task_bytes'
+ *  bytes and results of at most 'result_bytes', with 'depth' tasks
+ *  queued per worker.
+ */
+void farm_init (farm_t* f, MPI_Comm comm, int task_bytes, int result_bytes,
+                int depth);
+
+/**
+ *  Collective: runs tasks until next() returns FARM_DONE and every
+ *  result is done(). 'ctx' is passed to the callbacks. A client must not
+ *  return FARM_WAIT when no task is outstanding.
+ */
+void farm_run (farm_t* f, const farm_ops_t* ops, void* ctx);
+
+/** Collective: frees the requests and buffers. */
+void farm_free (farm_t* f);
+
+/**
+ *  Typed front end. 'Client' declares the types task_t and result_t and
+ *  the methods
+ *
+ *    int next (task_t* task);
+ *    int work (const task_t& task, result_t* result);  // returns a count
+ *    void done (const task_t& task, const result_t* result, int count);
+ *
+ *  task_t must be trivially copyable. 'max_results' bounds the count.
+ */
+template <typename Client>
+struct farm_client {
+  typedef typename Client::task_t task_t;
+  typedef typename Client::result_t result_t;
+
+  static int next (void* ctx, void* task) {
+    return ((Client*)ctx)->next ((task_t*)task);
+  }
+  static int work (void* ctx, const void* task, void* result) {
+    return sizeof (result_t)*((Client*)ctx)->work (*(const task_t*)task,
+                                                    (result_t*)result);
+  }
+  static void done (void* ctx, const void* task, const void* result, int bytes) {
+    ((Client*)ctx)->done (*(const task_t*)task, (const result_t*)result,
+                          bytes/sizeof (result_t));
+  }
+};
+
+template <typename Client>
+void farm_init (farm_t* f, MPI_Comm comm, int max_results, int depth) {
+  farm_init (f, comm, sizeof (typename Client::task_t),
+             max_results*sizeof (typename Client::result_t), depth);
+}
+
+template <typename Client>
+void farm_run (farm_t* f, Client* client) {
+  static const farm_ops_t ops = {
+    farm_client<Client>::next, farm_client<Client>::work, farm_client<Client>::done
+  };
+  farm_run (f, &ops, client);
+}
+
+#endif
+
+/* eof */
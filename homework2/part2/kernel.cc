@@ -0,0 +1,294 @@
+/**
+ *  \file kernel.cc
+ *
+ *  \brief Escape-time kernel shared by all Mandelbrot variants. See
+ *  'kernel.hh'.
+ */
+
+#include <cassert>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "kernel.hh"
+
+kernel_t kernel_default (void) {
+  kernel_t k;
+  memset (&k, 0, sizeof (k));
+  k.maxit = 511;
+  k.interior = false;
+  k.periodicity = false;
+  k.subdivide = false;
+  k.deep = false;
+  k.smooth = false;
+  k.cx = -0.7;
+  k.cy = 0;
+  k.span = 0;
+  return k;
+}
+
+int kernel_parse (int argc, char* argv[], kernel_t* k) {
+  int kept = 1;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp (argv[i], "-c") == 0) {
+      k->interior = true;
+    } else if (strcmp (argv[i], "-p") == 0) {
+      k->periodicity = true;
+    } else if (strcmp (argv[i], "-m") == 0) {
+      k->subdivide = true;
+    } else if (strcmp (argv[i], "-d") == 0) {
+      k->deep = true;
+    } else if (strcmp (argv[i], "-S") == 0) {
+      k->smooth = true;
+    } else if (strcmp (argv[i], "-n") == 0 && i + 1 < argc) {
+      k->maxit = atoi (argv[++i]);
+      if (k->maxit <= 0 || k->maxit > 0xffff) {
+        return 0;
+      }
+    } else if (strcmp (argv[i], "-x") == 0 && i + 1 < argc) {
+      k->cx = strtoflt128 (argv[++i], NULL);
+    } else if (strcmp (argv[i], "-y") == 0 && i + 1 < argc) {
+      k->cy = strtoflt128 (argv[++i], NULL);
+    } else if (strcmp (argv[i], "-z") == 0 && i + 1 < argc) {
+      k->span = strtoflt128 (argv[++i], NULL);
+      if (!(k->span > 0)) {
+        return 0;
+      }
+    } else if (argv[i][0] == '-' && argv[i][1] != '\0' && !isdigit (argv[i][1])) {
+      return 0;
+    } else {
+      argv[kept++] = argv[i];
+    }
+  }
+  return kept;
+}
+
+void kernel_usage (const char* prog) {
+  fprintf (stderr, "usage: %s [-c] [-p] [-m] [-d] [-S] [-n <maxit>] [-x <re>] [-y <im>] [-z <span>] <height> <width>\n", prog);
+  fprintf (stderr, "where <height> and <width> are the dimensions of the image,\n");
+  fprintf (stderr, "-c skips points inside the main cardioid and period-2 bulb,\n");
+  fprintf (stderr, "-p stops orbits that fall into a cycle (same image, less work),\n");
+  fprintf (stderr, "-m fills rectangles with uniform borders (Mariani-Silver),\n");
+  fprintf (stderr, "-S colours by the normalized iteration count, without bands,\n");
+  fprintf (stderr, "-n sets the iteration cap (default 511, at most 65535),\n");
+  fprintf (stderr, "-x and -y set the centre of the image (default -0.7, 0),\n");
+  fprintf (stderr, "-z sets the width of the image in the plane, with square pixels\n");
+  fprintf (stderr, "   (default: the classic 2.8 x 2.5 window), and\n");
+  fprintf (stderr, "-d renders by perturbation against a quad-precision reference\n");
+  fprintf (stderr, "   orbit at the centre, for spans far below 1e-13.\n");
+}
+
+void kernel_init (kernel_t* k, int height, int width) {
+  assert (height > 0 && width > 0);
+  if (k->span > 0) {
+    ref_t dx = k->span/width;
+    ref_t minX = k->cx - k->span/2;
+    ref_t minY = k->cy - dx*height/2;
+    k->minX = (double)minX;
+    k->minY = (double)minY;
+    k->dx = k->dy = (double)dx;
+    k->offX = (double)(-k->span/2);
+    k->offY = (double)(-dx*height/2);
+  } else {
+    // The classic window, -2.1..0.7 x -1.25..1.25 when left centred
+    double shiftX = (double)(k->cx + 0.7);
+    double shiftY = (double)k->cy;
+    double minX = -2.1 + shiftX, maxX = 0.7 + shiftX;
+    double minY = -1.25 + shiftY, maxY = 1.25 + shiftY;
+    k->minX = minX;
+    k->minY = minY;
+    k->dx = (maxX - minX)/width;
+    k->dy = (maxY - minY)/height;
+    k->offX = -1.4;
+    k->offY = -1.25;
+  }
+
+  k->ref_len = 0;
+  k->ref_x = k->ref_y = NULL;
+  if (!k->deep) {
+    return;
+  }
+
+  // Z_0 = 0, Z_{n+1} = Z_n^2 + C, kept until it escapes or runs past
+  // maxit; pixels that outlive it rebase onto its start.
+  k->ref_x = new double[k->maxit + 2];
+  k->ref_y = new double[k->maxit + 2];
+  ref_t zx = 0, zy = 0;
+  int n = 0;
+  while (true) {
+    k->ref_x[n] = (double)zx;
+    k->ref_y[n] = (double)zy;
+    ++n;
+    if (n == k->maxit + 2 || zx*zx + zy*zy > 4) {
+      break;
+    }
+    ref_t newx = zx*zx - zy*zy + k->cx;
+    zy = 2*zx*zy + k->cy;
+    zx = newx;
+  }
+  k->ref_len = n;
+}
+
+void kernel_free (kernel_t* k) {
+  delete[] k->ref_x;
+  delete[] k->ref_y;
+  k->ref_x = k->ref_y = NULL;
+  k->ref_len = 0;
+}
+
+int kernel_max_count (const kernel_t* k) {
+  return k->smooth ? 0xffff : k->maxit;
+}
+
+/** Extra iterations after escape before the smooth count is taken. */
+#define SMOOTH_STEPS 4
+
+/** Scales a normalized iteration count mu into 0..65535 (see kernel.hh). */
+static int
+smooth_scale (const kernel_t* k, double mu) {
+  double q = mu*65536/(k->maxit + 1);
+  return q < 0 ? 0 : q > 0xffff ? 0xffff : (int)q;
+}
+
+/** Count of a point that is still bounded after maxit iterations. */
+static int
+bounded (const kernel_t* k) {
+  return k->smooth ? smooth_scale (k, k->maxit) : k->maxit;
+}
+
+/**
+ *  Count of a point c = (cx, cy) whose orbit left the radius-2 disc at
+ *  z = (x, y) after 'it' iterations. With -S, a few more steps let |z|
+ *  grow until it - log2(ln|z|) no longer depends on where in the step
+ *  the orbit crossed the circle, which removes the bands.
+ */
+static int
+escaped (const kernel_t* k, int it, double x, double y, double cx, double cy) {
+  if (!k->smooth) {
+    return it;
+  }
+  for (int e = 0; e < SMOOTH_STEPS; ++e) {
+    double newx = x*x - y*y + cx;
+    y = 2*x*y + cy;
+    x = newx;
+  }
+  return smooth_scale (k, it + SMOOTH_STEPS - log2 (0.5*log (x*x + y*y)));
+}
+
+/**
+ *  True if (x, y) lies strictly inside the main cardioid or the period-2
+ *  bulb. Such points never escape, so the plain loop would run to maxit.
+ */
+static bool
+in_cardioid_or_bulb (double x, double y) {
+  double xq = x - 0.25;
+  double q = xq*xq + y*y;
+  if (q*(q + xq) < 0.25*y*y) {
+    return true;
+  }
+  return (x + 1)*(x + 1) + y*y < 0.0625;
+}
+
+int mandelbrot (const kernel_t* k, double x, double y) {
+  int maxit = k->maxit;
+  double cx = x;
+  double cy = y;
+  double newx, newy;
+
+  if (k->interior && in_cardioid_or_bulb (cx, cy)) {
+    return bounded (k);
+  }
+
+  int it = 0;
+  if (!k->periodicity) {
+    for (it = 0; it < maxit && (x*x + y*y) < 4; ++it) {
+      newx = x*x - y*y + cx;
+      newy = 2*x*y + cy;
+      x = newx;
+      y = newy;
+    }
+    return it == maxit ? bounded (k) : escaped (k, it, x, y, cx, cy);
+  }
+
+  // Brent: compare against a saved point, re-saved after 2, 4, 8, ...
+  // steps. Only an exact repeat counts, and an exactly repeating orbit
+  // can never escape, so the count matches the plain loop bit for bit.
+  double oldx = x, oldy = y;
+  int period = 0, limit = 2;
+  for (it = 0; it < maxit && (x*x + y*y) < 4; ++it) {
+    newx = x*x - y*y + cx;
+    newy = 2*x*y + cy;
+    x = newx;
+    y = newy;
+    if (x == oldx && y == oldy) {
+      return bounded (k);
+    }
+    if (++period == limit) {
+      oldx = x;
+      oldy = y;
+      period = 0;
+      limit *= 2;
+    }
+  }
+  return it == maxit ? bounded (k) : escaped (k, it, x, y, cx, cy);
+}
+
+/**
+ *  Perturbation kernel: z_n = Z_n + d_n with the reference orbit Z_n
+ *  and d_{n+1} = 2 Z_n d_n + d_n^2 + dc, where dc is the pixel's offset
+ *  from the centre. Only the small offsets live in double, so the pixel
+ *  spacing can go far below double's resolution of the coordinates.
+ *  When |z| drops below |d|, or the reference runs out, d is rebased
+ *  onto Z_0 = 0 (Zhuoran), which avoids the classic glitches.
+ */
+static int
+perturb (const kernel_t* k, double i, double j) {
+  const double* rx = k->ref_x;
+  const double* ry = k->ref_y;
+  double dcx = k->offX + j*k->dx;
+  double dcy = k->offY + i*k->dy;
+  double ex = 0, ey = 0;
+  int m = 0;
+  int it;
+  for (it = 0; it < k->maxit; ++it) {
+    double newx = 2*(rx[m]*ex - ry[m]*ey) + ex*ex - ey*ey + dcx;
+    double newy = 2*(rx[m]*ey + ry[m]*ex) + 2*ex*ey + dcy;
+    ex = newx;
+    ey = newy;
+    ++m;
+    double zx = rx[m] + ex;
+    double zy = ry[m] + ey;
+    double r2 = zx*zx + zy*zy;
+    if (r2 >= 4) {
+      //Past escape only the colour depends on z, so double's c will do
+      return escaped (k, it, zx, zy, k->minX + j*k->dx, k->minY + i*k->dy);
+    }
+    if (r2 < ex*ex + ey*ey || m == k->ref_len - 1) {
+      ex = zx;
+      ey = zy;
+      m = 0;
+    }
+  }
+  return bounded (k);
+}
+
+int mandelbrot_pixel (const kernel_t* k, int i, int j) {
+  return mandelbrot_sample (k, i, j);
+}
+
+int mandelbrot_sample (const kernel_t* k, double i, double j) {
+  if (k->deep) {
+    return perturb (k, i, j);
+  }
+  return mandelbrot (k, k->minX + j*k->dx, k->minY + i*k->dy);
+}
+
+void mandelbrot_row (const kernel_t* k, int i, int width, count_t* out) {
+  for (int j = 0; j < width; ++j) {
+    out[j] = mandelbrot_pixel (k, i, j);
+  }
+}
+
+/* eof */
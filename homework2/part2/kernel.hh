@@ -0,0 +1,79 @@
+#if !defined (INC_KERNEL_HH)
+#define INC_KERNEL_HH
+
+#include <quadmath.h>
+
+#include "counts.hh"
+
+/** High-precision real used for the viewport and the reference orbit. */
+typedef __float128 ref_t;
+
+/** Escape-time kernel settings; every rank uses the same ones for a run. */
+struct kernel_t {
+  int maxit;        /*!< -n: iteration cap; bounded points get this count */
+  bool interior;    /*!< -c: skip points in the main cardioid and period-2 bulb */
+  bool periodicity; /*!< -p: stop orbits that fall into an exact cycle */
+  bool subdivide;   /*!< -m: Mariani-Silver subdivision (see 'mariani.hh') */
+  bool deep;        /*!< -d: perturbation against a reference orbit;
+                         -c and -p only apply without it */
+  bool smooth;      /*!< -S: normalized (fractional) counts for smooth
+                         colouring; see kernel_max_count() */
+  ref_t cx, cy;     /*!< -x, -y: centre of the image */
+  ref_t span;       /*!< -z: width of the image in the plane; 0 keeps the
+                         classic 2.8 x 2.5 window around the centre */
+
+  /* Filled in by kernel_init () */
+  double minX, minY;   /*!< Corner of the image, pixel (0, 0) */
+  double dx, dy;       /*!< Pixel spacing */
+  double offX, offY;   /*!< Corner relative to the centre, for -d */
+  int ref_len;         /*!< Number of reference orbit points */
+  double *ref_x, *ref_y; /*!< Reference orbit Z_0 = 0, Z_1 = C, ... */
+};
+
+/** The plain kernel over the classic window: maxit = 511, no shortcuts. */
+kernel_t kernel_default (void);
+
+/**
+ *  Removes the kernel flags (see kernel_usage()) from argv[1:argc-1],
+ *  recording them in 'k', and returns the number of arguments left.
+ *  Any other argument is kept, in order. Returns 0 if a flag is
+ *  missing its value or the value is out of range.
+ */
+int kernel_parse (int argc, char* argv[], kernel_t* k);
+
+/** Prints the command-line help shared by all variants to stderr. */
+void kernel_usage (const char* prog);
+
+/**
+ *  Lays the viewport out over a height x width image and, with -d,
+ *  computes the reference orbit at the centre. Call before computing
+ *  any pixel; release with kernel_free().
+ */
+void kernel_init (kernel_t* k, int height, int width);
+
+/** Releases what kernel_init() allocated. */
+void kernel_free (kernel_t* k);
+
+/**
+ *  Largest count the kernel returns: maxit, or with -S 65535, where
+ *  counts are the normalized iteration count mu scaled so that
+ *  count/65536 = mu/(maxit+1). Either way count/(max+1) is the
+ *  colour position.
+ */
+int kernel_max_count (const kernel_t* k);
+
+/** Returns the escape-time iteration count of the point (x, y). */
+int mandelbrot (const kernel_t* k, double x, double y);
+
+/** Returns the iteration count of pixel (i, j), i.e. row i, column j. */
+int mandelbrot_pixel (const kernel_t* k, int i, int j);
+
+/** Like mandelbrot_pixel() at a point between pixel centres. */
+int mandelbrot_sample (const kernel_t* k, double i, double j);
+
+/** Computes the counts of row i into out[0:width-1]. */
+void mandelbrot_row (const kernel_t* k, int i, int width, count_t* out);
+
+#endif
+
+/* eof */
@@ -0,0 +1,18 @@
+/**
+ *  \file mandelbrot.cc
+ *  \brief Lab 2: Mandelbrot set with a choice of decompositions
+ *
+ *  One binary for every strategy, picked with '-s'; the files are named
+ *  after the strategy used.
+ */
+
+#include <cstddef>
+
+#include "engine.hh"
+
+int
+main(int argc, char* argv[]) {
+  return mandelbrot_main (argc, argv, NULL, STRATEGY_BLOCK);
+}
+
+/* eof */
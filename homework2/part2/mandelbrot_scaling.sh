@@ -0,0 +1,27 @@
+#!/bin/bash
+#$ -N Mandelbrot-Scaling
+#$ -q eecs221
+#$ -pe mpi 64
+#$ -R y
+
+# Grid Engine Notes:
+# -----------------
+# 1) Use "-R y" to request job reservation otherwise single 1-core jobs
+#    may prevent this multicore MPI job from running.   This is called
+#    job starvation.
+
+# Module load boost
+module load boost/1.57.0
+
+# Module load OpenMPI
+module load openmpi-1.8.3/gcc-4.9.2
+
+# Strong scaling of the cyclic, master/slave and work-stealing modes.
+# Per-rank timings go to scaling.csv; compare the 'total' and 'wait'
+# columns across np, and rank 0's 'comm' for the master bottleneck.
+rm -f scaling.csv
+for np in 2 4 8 16 32 64; do
+  for strategy in cyclic dynamic steal; do
+    mpirun -np ${np} ./mandelbrot -s ${strategy} -t scaling.csv 10000 10000
+  done
+done
@@ -0,0 +1,122 @@
+/**
+ *  \file mariani.cc
+ *
+ *  \brief Mariani-Silver rectangle subdivision. See 'mariani.hh'.
+ */
+
+#include <cassert>
+
+#include "mariani.hh"
+
+/** Rectangles with a side this short are computed pixel by pixel. */
+#define MS_MIN_SIDE 8
+
+/** Rectangles with fewer pixels than this do not spawn tasks. */
+#define MS_TASK_AREA 4096
+
+/** The image block being filled; rows are relative to 'row0'. */
+struct block_t {
+  const kernel_t* k;
+  int row0, width;
+  count_t* out;
+};
+
+static void
+compute (const block_t* b, int i, int j) {
+  b->out[i*b->width + j] = mandelbrot_pixel (b->k, b->row0 + i, j);
+}
+
+/**
+ *  Handles the w x h rectangle at (i0, j0), whose border pixels are
+ *  already computed, by filling or subdividing its interior. Sibling
+ *  rectangles share only border pixels, which nobody writes any more.
+ */
+static void
+subdivide (const block_t* b, int i0, int j0, int h, int w) {
+  if (h <= 2 || w <= 2) {
+    return;
+  }
+  count_t* out = b->out;
+  int stride = b->width;
+  count_t c = out[i0*stride + j0];
+  bool uniform = true;
+  for (int j = j0; uniform && j < j0 + w; ++j) {
+    uniform = out[i0*stride + j] == c && out[(i0 + h - 1)*stride + j] == c;
+  }
+  for (int i = i0; uniform && i < i0 + h; ++i) {
+    uniform = out[i*stride + j0] == c && out[i*stride + j0 + w - 1] == c;
+  }
+
+  if (uniform) {
+    for (int i = i0 + 1; i < i0 + h - 1; ++i) {
+      for (int j = j0 + 1; j < j0 + w - 1; ++j) {
+        out[i*stride + j] = c;
+      }
+    }
+    return;
+  }
+
+  if (h <= MS_MIN_SIDE || w <= MS_MIN_SIDE) {
+    for (int i = i0 + 1; i < i0 + h - 1; ++i) {
+      for (int j = j0 + 1; j < j0 + w - 1; ++j) {
+        compute (b, i, j);
+      }
+    }
+    return;
+  }
+
+  // Compute the middle row and column, which become the inner borders
+  // of the four quadrants.
+  int im = i0 + h/2;
+  int jm = j0 + w/2;
+  for (int j = j0 + 1; j < j0 + w - 1; ++j) {
+    compute (b, im, j);
+  }
+  for (int i = i0 + 1; i < i0 + h - 1; ++i) {
+    if (i != im) {
+      compute (b, i, jm);
+    }
+  }
+
+  int h0 = im - i0 + 1, h1 = i0 + h - im;
+  int w0 = jm - j0 + 1, w1 = j0 + w - jm;
+  bool spawn = h*w >= MS_TASK_AREA;
+  #pragma omp task if (spawn)
+  subdivide (b, i0, j0, h0, w0);
+  #pragma omp task if (spawn)
+  subdivide (b, i0, jm, h0, w1);
+  #pragma omp task if (spawn)
+  subdivide (b, im, j0, h1, w0);
+  subdivide (b, im, jm, h1, w1);
+  #pragma omp taskwait
+}
+
+void mariani_silver (const kernel_t* k, int width, int row0, int row1,
+                     count_t* out) {
+  assert (row0 <= row1 && width > 0);
+  block_t b = { k, row0, width, out };
+  int h = row1 - row0;
+  if (h < 3 || width < 3) {
+    for (int i = 0; i < h; ++i) {
+      for (int j = 0; j < width; ++j) {
+        compute (&b, i, j);
+      }
+    }
+    return;
+  }
+
+  for (int j = 0; j < width; ++j) {
+    compute (&b, 0, j);
+    compute (&b, h - 1, j);
+  }
+  for (int i = 1; i < h - 1; ++i) {
+    compute (&b, i, 0);
+    compute (&b, i, width - 1);
+  }
+
+  #pragma omp parallel
+  #pragma omp single
+  subdivide (&b, 0, 0, h, width);
+}
+
+/* eof */
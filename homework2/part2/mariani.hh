@@ -0,0 +1,22 @@
+#if !defined (INC_MARIANI_HH)
+#define INC_MARIANI_HH
+
+#include "kernel.hh"
+
+/**
+ *  Fills out[0:(row1-row0)*width-1] with the counts of image rows
+ *  [row0, row1) by Mariani-Silver subdivision: a rectangle whose border
+ *  has one uniform count is filled with it, otherwise it is split in
+ *  four and each part is handled as an OpenMP task. Pixels are computed
+ *  by mandelbrot_pixel(), so 'k' must have been through kernel_init().
+ *
+ *  Because the set is connected, a border that is all maxit encloses
+ *  only points of the set. Uniform escape-count borders are a (very
+ *  good) heuristic, so features thinner than a pixel can be lost.
+ */
+void mariani_silver (const kernel_t* k, int width, int row0, int row1,
+                     count_t* out);
+
+#endif
+
+/* eof */
@@ -0,0 +1,145 @@
+/**
+ *  \file output.cc
+ *
+ *  \brief Shared rendering and PNG output path. See 'output.hh'.
+ */
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "output.hh"
+
+/** Colour distance (see render_distance()) that marks an edge pixel. */
+#define EDGE_DISTANCE 32
+
+int output_parse (int argc, char* argv[], int* samples) {
+  int kept = 1;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp (argv[i], "-a") == 0 && i + 1 < argc) {
+      *samples = atoi (argv[++i]);
+      if (*samples < 1 || *samples > 16) {
+        return 0;
+      }
+    } else {
+      argv[kept++] = argv[i];
+    }
+  }
+  return kept;
+}
+
+void output_filename (char* buf, const char* name, int np, int height,
+                      int width, int frames, int f, const char* ext) {
+  int len = np == 1
+    ? sprintf(buf, "mandelbrot_%s_%dx%d", name, height, width)
+    : sprintf(buf, "mandelbrot_%s_%d_%dx%d", name, np, height, width);
+  if (frames > 1) {
+    len += sprintf(buf + len, "_%04d", f);
+  }
+  sprintf(buf + len, ".%s", ext);
+}
+
+void output_init (output_t* o, const char* name, int np, int height,
+                  int width, const kernel_t* base, const zoom_t* zoom,
+                  int samples) {
+  o->name = name;
+  o->np = np;
+  o->height = height;
+  o->width = width;
+  o->frames = zoom->frames;
+  o->samples = samples;
+  o->base = base;
+  o->zoom = zoom;
+  o->img[0] = new gil::rgb8_image_t(width, height);
+  o->img[1] = o->frames > 1 ? new gil::rgb8_image_t(width, height) : NULL;
+  o->encode_time = 0;
+  render_init (kernel_max_count (base));
+}
+
+/**
+ *  Anti-aliasing: averages the colours of n x n points spread over each
+ *  pixel whose colour differs from a neighbour's by EDGE_DISTANCE or
+ *  more. Pixels inside smooth areas keep their single sample, so the
+ *  cost follows the length of the boundary rather than the area.
+ */
+static void
+supersample (output_t* o, const count_t* counts, int f,
+             gil::rgb8_image_t* img) {
+  int height = o->height, width = o->width, n = o->samples;
+  kernel_t k;
+  zoom_frame (o->zoom, o->base, f, height, width, &k);
+  auto img_view = gil::view(*img);
+
+#pragma omp parallel for schedule(dynamic, 4)
+  for (int i = 0; i < height; ++i) {
+    const count_t *row = counts + (long)i*width;
+    gil::rgb8_pixel_t *out = img_view.row_begin(i);
+    for (int j = 0; j < width; ++j) {
+      int c = row[j];
+      bool edge = (j > 0 && render_distance (c, row[j - 1]) >= EDGE_DISTANCE)
+        || (j + 1 < width && render_distance (c, row[j + 1]) >= EDGE_DISTANCE)
+        || (i > 0 && render_distance (c, row[j - width]) >= EDGE_DISTANCE)
+        || (i + 1 < height && render_distance (c, row[j + width]) >= EDGE_DISTANCE);
+      if (!edge) {
+        continue;
+      }
+      int sum[3] = { 0, 0, 0 };
+      for (int a = 0; a < n; ++a) {
+        for (int b = 0; b < n; ++b) {
+          gil::rgb8_pixel_t p = render_count (
+            mandelbrot_sample (&k, i + (a + 0.5)/n - 0.5, j + (b + 0.5)/n - 0.5));
+          sum[0] += gil::at_c<0>(p);
+          sum[1] += gil::at_c<1>(p);
+          sum[2] += gil::at_c<2>(p);
+        }
+      }
+      out[j] = gil::rgb8_pixel_t(sum[0]/(n*n), sum[1]/(n*n), sum[2]/(n*n));
+    }
+  }
+  kernel_free (&k);
+}
+
+void output_frame (output_t* o, const count_t* counts, int f,
+                   profile_t* prof) {
+  gil::rgb8_image_t* img = o->img[f%2];
+  assert (img);
+  auto img_view = gil::view(*img);
+  for (int i = 0; i < o->height; ++i) {
+    render_row (img_view.row_begin(i), counts + (long)i*o->width, o->width);
+  }
+  if (o->samples > 1) {
+    supersample (o, counts, f, img);
+  }
+  profile_add (prof, PROF_RENDER);
+
+  if (o->encoder.joinable()) {
+    o->encoder.join();
+  }
+  profile_add (prof, PROF_WAIT);
+
+  char *filename = new char[128];
+  output_filename (filename, o->name, o->np, o->height, o->width, o->frames,
+                   f, "png");
+
+  double *encoded = &o->encode_time;
+  o->encoder = std::thread([filename, img, encoded] {
+    double t = profile_now ();
+    gil::png_write_view(filename, const_view(*img));
+    *encoded += profile_now () - t;
+    delete[] filename;
+  });
+}
+
+void output_finish (output_t* o, profile_t* prof) {
+  if (o->encoder.joinable()) {
+    o->encoder.join();
+  }
+  profile_add (prof, PROF_WAIT);
+  // The encoder overlaps the computation; report its own time
+  prof->phase[PROF_ENCODE] = o->encode_time;
+  delete o->img[0];
+  delete o->img[1];
+}
+
+/* eof */
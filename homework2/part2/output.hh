@@ -0,0 +1,64 @@
+#if !defined (INC_OUTPUT_HH)
+#define INC_OUTPUT_HH
+
+#include <thread>
+
+#include "render.hh"
+#include "profile.hh"
+#include "zoom.hh"
+
+/**
+ *  Turns finished frames of counts into PNG files. Each frame is
+ *  rendered into one of two images and written by a background thread,
+ *  so the caller can compute the next frame while it encodes.
+ */
+struct output_t {
+  const char* name;           /*!< Variant name used in the file names */
+  int np, height, width, frames;
+  int samples;                /*!< -a: N for NxN supersampling; 1 is off */
+  const kernel_t* base;       /*!< Kernel and zoom, to place the samples */
+  const zoom_t* zoom;
+  gil::rgb8_image_t* img[2];  /*!< Frame f is rendered into img[f%2] */
+  std::thread encoder;        /*!< Writes the last frame handed over */
+  double encode_time;         /*!< Seconds the encoder spent writing */
+};
+
+/**
+ *  Writes mandelbrot_<name>[_<np>]_<height>x<width>[_<frame>].<ext> to
+ *  'buf'; the rank count is left out when np is 1 and the frame number
+ *  when there is only one frame. 'buf' needs 128 bytes.
+ */
+void output_filename (char* buf, const char* name, int np, int height,
+                      int width, int frames, int f, const char* ext);
+
+/**
+ *  Removes '-a <N>' from argv[1:argc-1], setting *samples, and returns
+ *  the number of arguments left; 0 if N is out of range.
+ */
+int output_parse (int argc, char* argv[], int* samples);
+
+/**
+ *  Prepares to write the zoom->frames height x width PNG images named
+ *  by output_filename(), for counts from 'base' (zoomed by 'zoom', see
+ *  zoom_frame()). Also builds the colour table. Both must outlive 'o'.
+ *  With samples > 1, pixels whose colour jumps from a neighbour's are
+ *  averaged over samples x samples points across the pixel.
+ */
+void output_init (output_t* o, const char* name, int np, int height,
+                  int width, const kernel_t* base, const zoom_t* zoom,
+                  int samples);
+
+/**
+ *  Renders frame f from counts[0:height*width-1], supersampling where
+ *  needed, and starts writing it once the previous frame's file is
+ *  done. Charges the rendering and the wait for the encoder to 'prof'.
+ */
+void output_frame (output_t* o, const count_t* counts, int f,
+                   profile_t* prof);
+
+/** Waits for the last file and releases the images. */
+void output_finish (output_t* o, profile_t* prof);
+
+#endif
+
+/* eof */
@@ -0,0 +1,119 @@
+/**
+ *  \file profile.cc
+ *
+ *  \brief Per-rank phase timing and load-balance report. See
+ *  'profile.hh'.
+ */
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <sys/time.h>
+
+#include "profile.hh"
+
+static const char* phase_names[PROF_PHASES] = {
+  "compute", "wait", "comm", "render", "encode"
+};
+
+/** Number of doubles in a profile_t that are gathered. */
+#define PROF_WORDS (PROF_PHASES + 3)
+
+double profile_now (void) {
+  struct timeval t;
+  gettimeofday (&t, 0);
+  return (double)t.tv_sec + (double)t.tv_usec*1e-6;
+}
+
+void profile_init (profile_t* p) {
+  memset (p, 0, sizeof (*p));
+  p->start = p->mark = profile_now ();
+}
+
+void profile_mark (profile_t* p) {
+  p->mark = profile_now ();
+}
+
+void profile_add (profile_t* p, int phase) {
+  assert (phase >= 0 && phase < PROF_PHASES);
+  double now = profile_now ();
+  p->phase[phase] += now - p->mark;
+  p->mark = now;
+}
+
+int profile_parse (int argc, char* argv[], const char** csv) {
+  int kept = 1;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp (argv[i], "-t") == 0 && i + 1 < argc) {
+      *csv = argv[++i];
+    } else {
+      argv[kept++] = argv[i];
+    }
+  }
+  return kept;
+}
+
+/** Prints the summary and appends the CSV lines for 'np' gathered profiles. */
+static void
+summarize (const double* all, int np, const char* variant, int height,
+           int width, const char* csv) {
+  printf ("Per-rank breakdown (seconds; imbalance = max/mean):\n");
+  for (int w = 0; w < PROF_WORDS; ++w) {
+    double max = 0, sum = 0;
+    for (int r = 0; r < np; ++r) {
+      double v = all[r*PROF_WORDS + w];
+      sum += v;
+      max = v > max ? v : max;
+    }
+    double mean = sum/np;
+    const char* name = w < PROF_PHASES ? phase_names[w]
+      : w == PROF_PHASES ? "total" : w == PROF_PHASES + 1 ? "rows" : "bytes";
+    printf ("  %-8s max %12.6g  mean %12.6g  imbalance %6.3f\n",
+            name, max, mean, mean > 0 ? max/mean : 1.0);
+  }
+
+  if (csv == NULL) {
+    return;
+  }
+  FILE* fp = fopen (csv, "a");
+  assert (fp != NULL);
+  if (ftell (fp) == 0) {
+    fprintf (fp, "variant,np,height,width,rank");
+    for (int w = 0; w < PROF_PHASES; ++w) {
+      fprintf (fp, ",%s", phase_names[w]);
+    }
+    fprintf (fp, ",total,rows,bytes\n");
+  }
+  for (int r = 0; r < np; ++r) {
+    fprintf (fp, "%s,%d,%d,%d,%d", variant, np, height, width, r);
+    for (int w = 0; w < PROF_WORDS; ++w) {
+      fprintf (fp, ",%.9g", all[r*PROF_WORDS + w]);
+    }
+    fprintf (fp, "\n");
+  }
+  fclose (fp);
+}
+
+void profile_report (profile_t* p, const char* variant, int height,
+                     int width, const char* csv, MPI_Comm comm) {
+  int rank = 0, np = 0;
+  MPI_Comm_rank (comm, &rank);
+  MPI_Comm_size (comm, &np);
+  p->total = profile_now () - p->start;
+
+  double* all = rank == 0 ? new double[np*PROF_WORDS] : NULL;
+  MPI_Gather (p->phase, PROF_WORDS, MPI_DOUBLE, all, PROF_WORDS, MPI_DOUBLE,
+              0, comm);
+  if (rank == 0) {
+    summarize (all, np, variant, height, width, csv);
+    delete[] all;
+  }
+}
+
+void profile_report_serial (profile_t* p, const char* variant, int height,
+                            int width, const char* csv) {
+  p->total = profile_now () - p->start;
+  summarize (p->phase, 1, variant, height, width, csv);
+}
+
+/* eof */
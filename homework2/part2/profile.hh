@@ -0,0 +1,58 @@
+#if !defined (INC_PROFILE_HH)
+#define INC_PROFILE_HH
+
+#include <mpi.h>
+
+/** Phases a rank's time is split into. */
+enum {
+  PROF_COMPUTE, /*!< Escape-time kernel */
+  PROF_WAIT,    /*!< Blocked on other ranks: waiting for work or stragglers */
+  PROF_COMM,    /*!< Moving results: sends, receives, gathers, decoding */
+  PROF_RENDER,  /*!< Counts to RGB */
+  PROF_ENCODE,  /*!< Writing files: PNG encoding or raw MPI-IO */
+  PROF_PHASES
+};
+
+/** Per-rank timing and traffic counters; plain doubles so MPI can gather them. */
+struct profile_t {
+  double phase[PROF_PHASES]; /*!< Seconds spent in each phase */
+  double total;              /*!< Seconds from profile_init() to profile_report() */
+  double rows;               /*!< Image rows computed */
+  double bytes;              /*!< Bytes sent */
+  double start, mark;        /*!< Clock readings; see profile_add() */
+};
+
+/** Wall-clock seconds from an arbitrary origin. */
+double profile_now (void);
+
+/** Zeroes the counters and starts the clock. */
+void profile_init (profile_t* p);
+
+/** Starts timing a section; see profile_add(). */
+void profile_mark (profile_t* p);
+
+/** Charges the time since the last mark to 'phase' and marks again. */
+void profile_add (profile_t* p, int phase);
+
+/**
+ *  Removes '-t <file>' from argv[1:argc-1], setting *csv to the file,
+ *  and returns the number of arguments left.
+ */
+int profile_parse (int argc, char* argv[], const char** csv);
+
+/**
+ *  Collective: stops every rank's clock and gathers the profiles on
+ *  rank 0, which prints each phase's max, mean and imbalance (max/mean)
+ *  over ranks and, if 'csv' is not NULL, appends one line per rank to
+ *  that file. 'variant' names the distribution in the output.
+ */
+void profile_report (profile_t* p, const char* variant, int height,
+                     int width, const char* csv, MPI_Comm comm);
+
+/** Like profile_report() for a program that runs without MPI. */
+void profile_report_serial (profile_t* p, const char* variant, int height,
+                            int width, const char* csv);
+
+#endif
+
+/* eof */
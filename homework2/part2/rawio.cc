@@ -0,0 +1,110 @@
+/**
+ *  \file rawio.cc
+ *
+ *  \brief Raw count output through MPI-IO. See 'rawio.hh'.
+ */
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+#include "rawio.hh"
+
+const char* format_ext[NUM_FORMATS] = { "png", "pgm", "counts" };
+
+static const char* format_names[NUM_FORMATS] = { "png", "pgm", "raw" };
+
+int rawio_parse (int argc, char* argv[], int* format) {
+  int kept = 1;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp (argv[i], "-o") == 0 && i + 1 < argc) {
+      ++i;
+      int n = 0;
+      while (n < NUM_FORMATS && strcmp (argv[i], format_names[n]) != 0) {
+        ++n;
+      }
+      if (n == NUM_FORMATS) {
+        return 0;
+      }
+      *format = n;
+    } else {
+      argv[kept++] = argv[i];
+    }
+  }
+  return kept;
+}
+
+void rawio_open (rawio_t* r, MPI_Comm comm, const char* filename, int format,
+                 int height, int width, int max_count) {
+  assert (format == FORMAT_PGM || format == FORMAT_RAW);
+  r->comm = comm;
+  r->format = format;
+  r->width = width;
+  r->swapped = NULL;
+  r->swapped_len = 0;
+
+  //Everyone needs the header length to place their rows. Samples are
+  //always 16-bit, which PGM only allows with a maxval of 256 or more
+  char header[64];
+  int maxval = max_count < 256 ? 256 : max_count;
+  r->header = format == FORMAT_PGM
+    ? sprintf (header, "P5\n%d %d\n%d\n", width, height, maxval)
+    : 0;
+
+  int rank;
+  MPI_Comm_rank (comm, &rank);
+  MPI_File_open (comm, filename, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                 MPI_INFO_NULL, &r->fh);
+  MPI_File_set_size (r->fh, r->header + (MPI_Offset)height*width*sizeof (count_t));
+  if (rank == 0 && r->header > 0) {
+    MPI_File_write_at (r->fh, 0, header, r->header, MPI_CHAR, MPI_STATUS_IGNORE);
+  }
+}
+
+void rawio_write (rawio_t* r, const count_t* local, int chunks,
+                  const int* first, const int* rows) {
+  //Whole rows are the unit, so offsets into huge frames still fit
+  MPI_Datatype row_type, rows_type;
+  MPI_Type_contiguous (r->width, MPI_COUNT_T, &row_type);
+  MPI_Type_commit (&row_type);
+  MPI_Aint *offsets = new MPI_Aint[chunks > 0 ? chunks : 1];
+  int n = 0;
+  for (int c = 0; c < chunks; ++c) {
+    offsets[c] = (MPI_Aint)first[c]*r->width*sizeof (count_t);
+    n += rows[c];
+  }
+  //The file view picks this rank's rows out of the frame
+  MPI_Type_create_hindexed (chunks, rows, offsets, row_type, &rows_type);
+  MPI_Type_commit (&rows_type);
+  MPI_File_set_view (r->fh, r->header, row_type, rows_type, "native",
+                     MPI_INFO_NULL);
+
+  //PGM stores 16-bit samples most significant byte first; the hosts
+  //this runs on are little-endian
+  if (r->format == FORMAT_PGM) {
+    long len = (long)n*r->width;
+    if (len > r->swapped_len) {
+      delete[] r->swapped;
+      r->swapped = new count_t[len];
+      r->swapped_len = len;
+    }
+    for (long i = 0; i < len; ++i) {
+      r->swapped[i] = (count_t)((local[i] >> 8) | (local[i] << 8));
+    }
+    local = r->swapped;
+  }
+  MPI_File_write_at_all (r->fh, 0, local, n, row_type, MPI_STATUS_IGNORE);
+
+  MPI_Type_free (&rows_type);
+  MPI_Type_free (&row_type);
+  delete[] offsets;
+}
+
+void rawio_close (rawio_t* r) {
+  MPI_File_close (&r->fh);
+  delete[] r->swapped;
+  r->swapped = NULL;
+  r->swapped_len = 0;
+}
+
+/* eof */
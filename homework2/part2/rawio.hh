@@ -0,0 +1,62 @@
+#if !defined (INC_RAWIO_HH)
+#define INC_RAWIO_HH
+
+#include <mpi.h>
+
+#include "counts.hh"
+
+/**
+ *  Raw output through MPI-IO: every rank writes the rows it computed
+ *  straight to the file, so no rank needs to hold a whole frame.
+ */
+
+/** Output formats selected with '-o'. */
+enum {
+  FORMAT_PNG,  /*!< Coloured PNG assembled on rank 0 (default) */
+  FORMAT_PGM,  /*!< 16-bit greyscale PGM of the iteration counts */
+  FORMAT_RAW,  /*!< Bare native-endian count_t array, row after row */
+  NUM_FORMATS
+};
+
+/** File extension for each format. */
+extern const char* format_ext[NUM_FORMATS];
+
+struct rawio_t {
+  MPI_Comm comm;
+  MPI_File fh;
+  int format;
+  int width;
+  MPI_Offset header;  /*!< Bytes before the first count */
+  count_t* swapped;   /*!< PGM: big-endian copy of the counts written */
+  long swapped_len;
+};
+
+/**
+ *  Removes '-o <png|pgm|raw>' from argv[1:argc-1], setting *format, and
+ *  returns the number of arguments left; 0 if the format is unknown.
+ */
+int rawio_parse (int argc, char* argv[], int* format);
+
+/**
+ *  Collective over 'comm': creates 'filename' for a height x width
+ *  frame in 'format', with the PGM header (max value 'max_count', raised
+ *  to 256 so that the samples are 16-bit by the format) written by the
+ *  first rank.
+ */
+void rawio_open (rawio_t* r, MPI_Comm comm, const char* filename, int format,
+                 int height, int width, int max_count);
+
+/**
+ *  Collective: writes this rank's chunks, rows first[c] to
+ *  first[c]+rows[c]-1 for c < chunks, stored one after another in
+ *  'local', with a single MPI_File_write_at_all.
+ */
+void rawio_write (rawio_t* r, const count_t* local, int chunks,
+                  const int* first, const int* rows);
+
+/** Collective: closes the file. */
+void rawio_close (rawio_t* r);
+
+#endif
+
+/* eof */
@@ -7,9 +7,16 @@
 #include <cassert>
 #include <iostream>
 #include <cstdlib>
+#if defined (__AVX2__)
+#include <immintrin.h>
+#endif
 
 #include "render.hh"
 
+/** Colour lookup table; one packed 0x00BBGGRR entry per iteration count. */
+static uint32_t *palette = NULL;
+static int palette_size = 0;
+
 /** Construct a color suitable for display. */
 gil::rgb8_pixel_t render(float v) {
   // Use smooth polynomials for r, g, b
@@ -19,4 +26,60 @@ gil::rgb8_pixel_t render(float v) {
   return gil::rgb8_pixel_t(r, g, b);
 }
 
+void render_init (int maxit) {
+  assert (maxit > 0);
+  delete[] palette;
+  palette_size = maxit + 1;
+  palette = new uint32_t[palette_size];
+  for (int c = 0; c < palette_size; ++c) {
+    gil::rgb8_pixel_t p = render ((float)(c/(double)palette_size));
+    palette[c] = (uint32_t)gil::at_c<0>(p)
+      | ((uint32_t)gil::at_c<1>(p) << 8)
+      | ((uint32_t)gil::at_c<2>(p) << 16);
+  }
+}
+
+gil::rgb8_pixel_t render_count (int count) {
+  assert (palette && count >= 0 && count < palette_size);
+  uint32_t p = palette[count];
+  return gil::rgb8_pixel_t(p & 0xff, (p >> 8) & 0xff, (p >> 16) & 0xff);
+}
+
+int render_distance (int a, int b) {
+  assert (palette && a >= 0 && a < palette_size && b >= 0 && b < palette_size);
+  uint32_t p = palette[a], q = palette[b];
+  int d = 0;
+  for (int shift = 0; shift < 24; shift += 8) {
+    d += abs ((int)((p >> shift) & 0xff) - (int)((q >> shift) & 0xff));
+  }
+  return d;
+}
+
+void render_row (gil::rgb8_pixel_t* row, const count_t* counts, int width) {
+  assert (palette);
+  int j = 0;
+#if defined (__AVX2__)
+  // Gather 8 packed colours at a time and squeeze out the pad bytes.
+  // Each 16-byte store spills 4 bytes past its 12 useful ones, so stop
+  // while at least two pixels of the row are still left for the tail.
+  const __m256i pack = _mm256_setr_epi8 (0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14,
+                                         -1, -1, -1, -1,
+                                         0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14,
+                                         -1, -1, -1, -1);
+  uint8_t* out = (uint8_t*)row;
+  for (; j + 10 <= width; j += 8) {
+    __m256i idx = _mm256_cvtepu16_epi32 (
+      _mm_loadu_si128 ((const __m128i*)(counts + j)));
+    __m256i rgbx = _mm256_i32gather_epi32 ((const int*)palette, idx, 4);
+    __m256i rgb = _mm256_shuffle_epi8 (rgbx, pack);
+    _mm_storeu_si128 ((__m128i*)(out + 3*j), _mm256_castsi256_si128 (rgb));
+    _mm_storeu_si128 ((__m128i*)(out + 3*j + 12),
+                      _mm256_extracti128_si256 (rgb, 1));
+  }
+#endif
+  for (; j < width; ++j) {
+    row[j] = render_count (counts[j]);
+  }
+}
+
 /* eof */
@@ -6,9 +6,30 @@
 #include <boost/gil/gil_all.hpp>
 #include <boost/gil/extension/io/png_dynamic_io.hpp>
 
+#include "counts.hh"
+
 namespace gil = boost::gil;
 
 /** Construct a color suitable for display. */
 gil::rgb8_pixel_t render(float v);
 
+/**
+ *  Builds the colour lookup table for iteration counts 0..maxit, so
+ *  that count 'c' gets the colour render(c/(maxit+1)). Call once
+ *  before render_count() or render_row().
+ */
+void render_init (int maxit);
+
+/** Colour for an integer iteration count, via the lookup table. */
+gil::rgb8_pixel_t render_count (int count);
+
+/**
+ *  How far apart the colours of counts a and b are: the sum of the
+ *  absolute differences of their channels, 0..765.
+ */
+int render_distance (int a, int b);
+
+/** Colours 'width' iteration counts into 'row' via the lookup table. */
+void render_row (gil::rgb8_pixel_t* row, const count_t* counts, int width);
+
 #endif
@@ -0,0 +1,93 @@
+/**
+ *  \file zoom.cc
+ *
+ *  \brief Zoom sequences with frame-to-frame pixel reuse. See 'zoom.hh'.
+ */
+
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "zoom.hh"
+
+zoom_t zoom_default (void) {
+  zoom_t z;
+  z.frames = 1;
+  z.factor = 2;
+  z.q = 0;
+  z.shift_row = z.shift_col = 0;
+  return z;
+}
+
+int zoom_parse (int argc, char* argv[], zoom_t* z) {
+  int kept = 1;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp (argv[i], "-f") == 0 && i + 1 < argc) {
+      z->frames = atoi (argv[++i]);
+      if (z->frames <= 0) {
+        return 0;
+      }
+    } else if (strcmp (argv[i], "-k") == 0 && i + 1 < argc) {
+      z->factor = atof (argv[++i]);
+      if (!(z->factor > 0)) {
+        return 0;
+      }
+    } else {
+      argv[kept++] = argv[i];
+    }
+  }
+  return kept;
+}
+
+void zoom_init (zoom_t* z, int height, int width) {
+  // Frame f+1 pixel j sits at c + (j - W/2)*dx/q and frame f pixel j' at
+  // c + (j' - W/2)*dx, so j' = (j + (q-1)*W/2)/q whenever that divides.
+  z->q = 0;
+  z->shift_row = z->shift_col = 0;
+  int q = (int)floor (z->factor + 0.5);
+  if (z->frames < 2 || q < 2 || fabs (z->factor - q) > 1e-12) {
+    return;
+  }
+  if ((q - 1)*height % 2 != 0 || (q - 1)*width % 2 != 0) {
+    return;
+  }
+  z->q = q;
+  z->shift_row = (q - 1)*height/2;
+  z->shift_col = (q - 1)*width/2;
+}
+
+void zoom_frame (const zoom_t* z, const kernel_t* base, int f,
+                 int height, int width, kernel_t* k) {
+  *k = *base;
+  if (z->frames > 1 && !(k->span > 0)) {
+    k->span = 2.8;
+  }
+  for (int n = 0; n < f; ++n) {
+    k->span /= z->factor;
+  }
+  kernel_init (k, height, width);
+}
+
+bool zoom_reused (const zoom_t* z, int f, int i, int j) {
+  return f > 0 && z->q
+    && (i + z->shift_row) % z->q == 0 && (j + z->shift_col) % z->q == 0;
+}
+
+void zoom_fill (const zoom_t* z, const count_t* prev, count_t* cur,
+                int height, int width) {
+  if (!z->q) {
+    return;
+  }
+  int q = z->q;
+  int j0 = (q - z->shift_col % q) % q;
+  for (int i = (q - z->shift_row % q) % q; i < height; i += q) {
+    const count_t* from = prev + ((i + z->shift_row)/q)*width;
+    count_t* to = cur + i*width;
+    for (int j = j0; j < width; j += q) {
+      to[j] = from[(j + z->shift_col)/q];
+    }
+  }
+}
+
+/* eof */
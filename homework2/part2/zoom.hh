@@ -0,0 +1,54 @@
+#if !defined (INC_ZOOM_HH)
+#define INC_ZOOM_HH
+
+#include "kernel.hh"
+
+/**
+ *  A zoom sequence about the kernel's centre: frame f spans the width of
+ *  frame 0 divided by factor^f.
+ */
+struct zoom_t {
+  int frames;     /*!< -f: number of frames; 1 renders a single image */
+  double factor;  /*!< -k: zoom between consecutive frames (default 2) */
+
+  /* Filled in by zoom_init () */
+  int q;          /*!< 'factor' if it is an integer >= 2 whose grid
+                       lines up with the previous frame's, else 0 */
+  int shift_row;  /*!< (q-1)*height/2 */
+  int shift_col;  /*!< (q-1)*width/2 */
+};
+
+/** A single frame, no zoom. */
+zoom_t zoom_default (void);
+
+/**
+ *  Removes the zoom flags ('-f <frames>', '-k <factor>') from
+ *  argv[1:argc-1] and returns the number of arguments left; 0 if a
+ *  value is missing or out of range. Call before kernel_parse().
+ */
+int zoom_parse (int argc, char* argv[], zoom_t* z);
+
+/** Works out whether consecutive frames of this size share pixels. */
+void zoom_init (zoom_t* z, int height, int width);
+
+/**
+ *  Sets 'k' up for frame f: a copy of 'base' with the frame's span,
+ *  through kernel_init(). Release with kernel_free(). A sequence needs
+ *  square pixels, so a base without -z starts from a span of 2.8.
+ */
+void zoom_frame (const zoom_t* z, const kernel_t* base, int f,
+                 int height, int width, kernel_t* k);
+
+/**
+ *  True if pixel (i, j) of frame f > 0 is, up to rounding, the same
+ *  point as a pixel of frame f-1, so it need not be computed.
+ */
+bool zoom_reused (const zoom_t* z, int f, int i, int j);
+
+/** Copies the reused pixels of a frame from the previous frame's counts. */
+void zoom_fill (const zoom_t* z, const count_t* prev, count_t* cur,
+                int height, int width);
+
+#endif
+
+/* eof */
@@ -0,0 +1,192 @@
+/**
+ *  \file batch.cc
+ *  \brief Batched multiplies of many small matrices
+ */
+
+#include <assert.h>
+#include <stddef.h>
+#include <omp.h>
+
+#include "batch.hh"
+#include "simd.hh"
+
+/** The largest divisor of N no greater than R (or 1). */
+template <int N, int R>
+struct divisor {
+  enum { value = R <= 1 ? 1 : N % R == 0 ? R : divisor<N, R - 1>::value };
+};
+
+template <int N>
+struct divisor<N, 0> {
+  enum { value = 1 };
+};
+
+/** The same loops for any shape, a row of C at a time. */
+template <typename T>
+static void general (int N, int K, int M, const T* A, const T* B, T* C);
+
+#if defined (__AVX2__) && defined (__FMA__)
+
+#define TILE_VECTORS 12 /*!< Accumulators per tile, as in the GEMM kernels */
+
+/**
+ *  C += A * B for one N x K x M product, all known at compile time. C is
+ *  covered by R x JV tiles of vectors, R dividing N and JV dividing the
+ *  row's vectors, with at most TILE_VECTORS accumulators. Each tile is
+ *  summed over all of K in registers, B read straight from its rows,
+ *  and every loop but k's is unrolled completely. Rows that are not a
+ *  whole number of vectors go to general().
+ */
+template <typename T, int N, int K, int M>
+static void fixed (int, int, int, const T* A, const T* B, T* C)
+{
+  typedef simd<T, T> S;
+  enum { L = lanes<T>::value, V = M / L,
+         JV = divisor<V, 3>::value,
+         R = divisor<N, TILE_VECTORS / JV>::value };
+  if (M % L != 0) {
+    general<T> (N, K, M, A, B, C);
+    return;
+  }
+
+  for (int i = 0; i < N; i += R)
+    for (int jv = 0; jv < V; jv += JV) {
+      typename S::vec c[R][JV];
+#pragma GCC unroll 16
+      for (int r = 0; r < R; ++r)
+#pragma GCC unroll 16
+        for (int v = 0; v < JV; ++v)
+          c[r][v] = S::zero ();
+
+      for (int k = 0; k < K; ++k) {
+        typename S::vec b[JV];
+#pragma GCC unroll 16
+        for (int v = 0; v < JV; ++v)
+          b[v] = S::loadu (B + k * M + (jv + v) * L);
+#pragma GCC unroll 16
+        for (int r = 0; r < R; ++r) {
+          typename S::vec a = S::bcast (A + (i + r) * K + k);
+#pragma GCC unroll 16
+          for (int v = 0; v < JV; ++v)
+            c[r][v] = S::fmadd (a, b[v], c[r][v]);
+        }
+      }
+
+#pragma GCC unroll 16
+      for (int r = 0; r < R; ++r)
+#pragma GCC unroll 16
+        for (int v = 0; v < JV; ++v)
+          S::update (C + (i + r) * M + (jv + v) * L, c[r][v]);
+    }
+}
+
+#else
+
+/** Portable kernel: the loops of general() with constant bounds. */
+template <typename T, int N, int K, int M>
+static void fixed (int, int, int, const T* A, const T* B, T* C)
+{
+  for (int i = 0; i < N; ++i)
+    for (int k = 0; k < K; ++k) {
+      const T a = A[i * K + k];
+      for (int j = 0; j < M; ++j)
+        C[i * M + j] += a * B[k * M + j];
+    }
+}
+
+#endif
+
+/** The same loops for any shape, a row of C at a time. */
+template <typename T>
+static void general (int N, int K, int M, const T* A, const T* B, T* C)
+{
+  for (int i = 0; i < N; ++i) {
+    T* __restrict__ Ci = C + (size_t)i * M;
+    for (int k = 0; k < K; ++k) {
+      const T a = A[(size_t)i * K + k];
+      const T* __restrict__ Bk = B + (size_t)k * M;
+      for (int j = 0; j < M; ++j)
+        Ci[j] += a * Bk[j];
+    }
+  }
+}
+
+template <typename T>
+struct small_fn {
+  typedef void (*type) (int, int, int, const T*, const T*, T*);
+};
+
+/** Sizes with a fixed kernel. */
+static const int sizes[] = { 4, 8, 12, 16, 24, 32, 48, 64 };
+#define NUM_SIZES ((int)(sizeof (sizes) / sizeof (sizes[0])))
+
+bool gemm_batch_fixed (int N, int K, int M)
+{
+  for (int s = 0; s < NUM_SIZES; ++s)
+    if (N == sizes[s] && K == sizes[s] && M == sizes[s])
+      return true;
+  return false;
+}
+
+/** The kernel for an N x K x M product. */
+template <typename T>
+static typename small_fn<T>::type find_small (int N, int K, int M)
+{
+  static const typename small_fn<T>::type kernels[NUM_SIZES] = {
+    fixed<T, 4, 4, 4>, fixed<T, 8, 8, 8>, fixed<T, 12, 12, 12>,
+    fixed<T, 16, 16, 16>, fixed<T, 24, 24, 24>, fixed<T, 32, 32, 32>,
+    fixed<T, 48, 48, 48>, fixed<T, 64, 64, 64>
+  };
+  for (int s = 0; s < NUM_SIZES; ++s)
+    if (N == sizes[s] && K == sizes[s] && M == sizes[s])
+      return kernels[s];
+  return general<T>;
+}
+
+template <typename T>
+void gemm_small (int N, int K, int M, const T* A, const T* B, T* C)
+{
+  assert (A && B && C && N >= 0 && K >= 0 && M >= 0);
+  find_small<T> (N, K, M) (N, K, M, A, B, C);
+}
+
+template <typename T>
+void gemm_batch_strided (int N, int K, int M, const T* A, long stride_a,
+                         const T* B, long stride_b, T* C, long stride_c,
+                         int count)
+{
+  assert (A && B && C && N >= 0 && K >= 0 && M >= 0 && count >= 0);
+  assert (stride_a >= 0 && stride_b >= 0 && stride_c >= (long)N * M);
+  const typename small_fn<T>::type kernel = find_small<T> (N, K, M);
+  const bool parallel = (double)N * K * M * count >= BATCH_PARALLEL_MIN;
+
+#pragma omp parallel for schedule(static) if(parallel)
+  for (int b = 0; b < count; ++b)
+    kernel (N, K, M, A + b * stride_a, B + b * stride_b, C + b * stride_c);
+}
+
+template <typename T>
+void gemm_batch (int N, int K, int M, const T* const* A, const T* const* B,
+                 T* const* C, int count)
+{
+  assert (A && B && C && N >= 0 && K >= 0 && M >= 0 && count >= 0);
+  const typename small_fn<T>::type kernel = find_small<T> (N, K, M);
+  const bool parallel = (double)N * K * M * count >= BATCH_PARALLEL_MIN;
+
+#pragma omp parallel for schedule(static) if(parallel)
+  for (int b = 0; b < count; ++b)
+    kernel (N, K, M, A[b], B[b], C[b]);
+}
+
+/* The element types built */
+#define BATCH_INSTANTIATE(T) \
+  template void gemm_small<T> (int, int, int, const T*, const T*, T*); \
+  template void gemm_batch_strided<T> (int, int, int, const T*, long, \
+                                       const T*, long, T*, long, int); \
+  template void gemm_batch<T> (int, int, int, const T* const*, \
+                               const T* const*, T* const*, int);
+
+BATCH_INSTANTIATE (double)
+BATCH_INSTANTIATE (float)
+
+// eof
@@ -0,0 +1,53 @@
+/**
+ *  \file batch.hh
+ *  \brief Batched multiplies of many small matrices
+ *
+ *  For sizes up to 64 or so the packed GEMM's packing and blocking cost
+ *  more than the multiply itself, and so would parallelizing a single
+ *  product. Here each product runs on one thread, straight from the
+ *  row-major operands, and the threads split the batch between them.
+ *  Nothing is allocated per call.
+ *
+ *  Square sizes 4, 8, 12, 16, 24, 32, 48 and 64 have kernels generated
+ *  for their exact dimensions, whose loops the compiler unrolls
+ *  completely: a block of C rows stays in registers while A's entries
+ *  are broadcast against rows of B. Other shapes use the same scheme
+ *  with run-time bounds.
+ */
+
+#if !defined (INC_BATCH_HH)
+#define INC_BATCH_HH
+
+/** Batches with fewer multiply-adds than this run on one thread. */
+#define BATCH_PARALLEL_MIN 65536
+
+/** Whether N x K x M has a fixed-size kernel. */
+bool gemm_batch_fixed (int N, int K, int M);
+
+/**
+ *  C_i += A_i * B_i for i < count, each A_i N x K, B_i K x M and C_i
+ *  N x M, row-major and dense, at A + i * stride_a and so on. A stride
+ *  of 0 uses the same operand for every product; the C_i must not
+ *  overlap. Built for double and float.
+ */
+template <typename T>
+void gemm_batch_strided (int N, int K, int M, const T* A, long stride_a,
+                         const T* B, long stride_b, T* C, long stride_c,
+                         int count);
+
+/**
+ *  C += A * B for a single product, sized and stored as one of a batch,
+ *  on the calling thread; for callers with products of their own to
+ *  share out between threads.
+ */
+template <typename T>
+void gemm_small (int N, int K, int M, const T* A, const T* B, T* C);
+
+/** As gemm_batch_strided(), with the operands given by pointer arrays. */
+template <typename T>
+void gemm_batch (int N, int K, int M, const T* const* A, const T* const* B,
+                 T* const* C, int count);
+
+#endif
+
+// eof
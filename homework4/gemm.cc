@@ -0,0 +1,474 @@
+/**
+ *  \file gemm.cc
+ *  \brief Packed, register-blocked matrix multiply
+ */
+
+#include <assert.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include "gemm.hh"
+#include "simd.hh"
+
+/** Cache-line aligned allocation of n elements of type T. */
+template <typename T>
+static T* alloc_packed (size_t n)
+{
+  void* p = NULL;
+  int err = posix_memalign (&p, 64, n * sizeof (T));
+  assert (err == 0 && p);
+  return (T *)p;
+}
+
+/** The current settings. */
+static gemm_config_t config = { GEMM_MR, GEMM_NR, GEMM_MC, GEMM_KC, GEMM_NC };
+
+/** n bytes rounded up to whole cache lines. */
+static size_t round_line (size_t n)
+{
+  return (n + 63) / 64 * 64;
+}
+
+/**
+ *  Packing space for a call on 'threads' threads: the shared panel of B,
+ *  then each thread's block of A. Sized for doubles, and for the widest
+ *  tile in columns, so that it serves every element type.
+ */
+static size_t panel_bytes (const gemm_config_t& cfg)
+{
+  int nr = cfg.nr / lanes<double>::value * lanes<float>::value;
+  return round_line ((size_t)cfg.kc * ((cfg.nc + nr - 1) / nr * nr)
+                     * sizeof (double));
+}
+
+static size_t block_bytes (const gemm_config_t& cfg)
+{
+  return round_line ((size_t)cfg.mc * cfg.kc * sizeof (double));
+}
+
+static size_t workspace_bytes (const gemm_config_t& cfg, int threads)
+{
+  return panel_bytes (cfg) + (size_t)threads * block_bytes (cfg);
+}
+
+/**
+ *  Each calling thread's packing space, kept from call to call and grown
+ *  when a call needs more, so that timed calls do not allocate.
+ */
+static char* own_work = NULL;
+static size_t own_work_size = 0;
+#pragma omp threadprivate(own_work, own_work_size)
+
+static char* own_workspace (size_t bytes)
+{
+  if (bytes > own_work_size) {
+    free (own_work);
+    own_work = alloc_packed<char> (bytes);
+    own_work_size = bytes;
+  }
+  return own_work;
+}
+
+/**
+ *  Packs the mc x kc block of A at 'A' (leading dimension lda) into
+ *  mr-row slivers: sliver p holds rows p*mr..p*mr+mr-1 column by column,
+ *  so the micro-kernel reads mr consecutive values per k. Rows past mc
+ *  are zero. Values are converted to the accumulator type here, once,
+ *  rather than in the micro-kernel for every tile they meet.
+ */
+template <typename T, typename Acc>
+static void pack_A (Acc* Ap, const T* A, int lda, int mc, int kc, int mr)
+{
+  for (int i = 0; i < mc; i += mr) {
+    int rows = mc - i < mr ? mc - i : mr;
+    for (int k = 0; k < kc; ++k) {
+      int r;
+      for (r = 0; r < rows; ++r)
+        Ap[r] = A[(size_t)(i + r) * lda + k];
+      for (; r < mr; ++r)
+        Ap[r] = 0;
+      Ap += mr;
+    }
+  }
+}
+
+/**
+ *  Packs the kc x nc panel of B at 'B' (leading dimension ldb) into
+ *  nr-column slivers, row by row. Columns past nc are zero.
+ */
+template <typename T>
+static void pack_B (T* Bp, const T* B, int ldb, int kc, int nc, int nr)
+{
+  for (int j = 0; j < nc; j += nr) {
+    int cols = nc - j < nr ? nc - j : nr;
+    for (int k = 0; k < kc; ++k) {
+      const T* b = B + (size_t)k * ldb + j;
+      int c;
+      for (c = 0; c < cols; ++c)
+        Bp[c] = b[c];
+      for (; c < nr; ++c)
+        Bp[c] = 0;
+      Bp += nr;
+    }
+  }
+}
+
+/**
+ *  C[0:mr-1][0:nr-1] += Ap * Bp over kc, C with leading dimension ldc.
+ *  B is stored as T; packed A and C as Acc, which is also what the
+ *  products are accumulated in.
+ */
+template <typename T, typename Acc>
+struct kernel_fn {
+  typedef void (*type) (int kc, const Acc* Ap, const T* Bp, Acc* C, int ldc);
+};
+
+#if defined (__AVX2__) && defined (__FMA__)
+
+/**
+ *  MR rows by NV vectors: each k broadcasts MR values of A against NV
+ *  vectors of B. The loops over r and v are unrolled completely, which
+ *  is what lets GCC keep the accumulators in registers rather than in a
+ *  stack array.
+ */
+template <typename T, typename Acc, int MR, int NV>
+static void kernel (int kc, const Acc* Ap, const T* Bp, Acc* C, int ldc)
+{
+  typedef simd<T, Acc> S;
+  const int L = lanes<Acc>::value;
+  typename S::vec c[MR][NV];
+#pragma GCC unroll 16
+  for (int r = 0; r < MR; ++r)
+#pragma GCC unroll 16
+    for (int v = 0; v < NV; ++v)
+      c[r][v] = S::zero ();
+
+  for (int k = 0; k < kc; ++k) {
+    typename S::vec b[NV];
+#pragma GCC unroll 16
+    for (int v = 0; v < NV; ++v)
+      b[v] = S::load (Bp + L * v);
+#pragma GCC unroll 16
+    for (int r = 0; r < MR; ++r) {
+      typename S::vec a = S::bcast (Ap + r);
+#pragma GCC unroll 16
+      for (int v = 0; v < NV; ++v)
+        c[r][v] = S::fmadd (a, b[v], c[r][v]);
+    }
+    Ap += MR;
+    Bp += L * NV;
+  }
+
+#pragma GCC unroll 16
+  for (int r = 0; r < MR; ++r)
+#pragma GCC unroll 16
+    for (int v = 0; v < NV; ++v)
+      S::update (C + (size_t)r * ldc + L * v, c[r][v]);
+}
+
+#else
+
+/** Portable kernel of the same shape; the compiler may vectorize it. */
+template <typename T, typename Acc, int MR, int NV>
+static void kernel (int kc, const Acc* Ap, const T* Bp, Acc* C, int ldc)
+{
+  const int NR = NV * lanes<Acc>::value;
+  Acc c[MR][NR] = { { 0 } };
+  for (int k = 0; k < kc; ++k) {
+    for (int r = 0; r < MR; ++r)
+      for (int j = 0; j < NR; ++j)
+        c[r][j] += Ap[r] * (Acc)Bp[j];
+    Ap += MR;
+    Bp += NR;
+  }
+  for (int r = 0; r < MR; ++r)
+    for (int j = 0; j < NR; ++j)
+      C[(size_t)r * ldc + j] += c[r][j];
+}
+
+#endif
+
+/**
+ *  Micro-tile shapes, as rows and vectors, for every element type; the
+ *  first is the default. gemm_config_t gives their width in doubles.
+ */
+static const int shapes[][2] = { { 6, 2 }, { 4, 2 }, { 8, 1 }, { 4, 3 }, { 8, 2 } };
+#define NUM_SHAPES ((int)(sizeof (shapes) / sizeof (shapes[0])))
+#define MAX_TILE 128 /*!< Largest mr * nr, in accumulator elements */
+
+/** The kernel for an mr-row, nv-vector tile, or NULL. */
+template <typename T, typename Acc>
+static typename kernel_fn<T, Acc>::type find_kernel (int mr, int nv)
+{
+  static const typename kernel_fn<T, Acc>::type kernels[NUM_SHAPES] = {
+    kernel<T, Acc, 6, 2>, kernel<T, Acc, 4, 2>, kernel<T, Acc, 8, 1>,
+    kernel<T, Acc, 4, 3>, kernel<T, Acc, 8, 2>
+  };
+  for (int i = 0; i < NUM_SHAPES; ++i)
+    if (shapes[i][0] == mr && shapes[i][1] == nv)
+      return kernels[i];
+  return NULL;
+}
+
+int gemm_tile_shapes (const int (**s)[2])
+{
+  static int in_doubles[NUM_SHAPES][2];
+  for (int i = 0; i < NUM_SHAPES; ++i) {
+    in_doubles[i][0] = shapes[i][0];
+    in_doubles[i][1] = shapes[i][1] * lanes<double>::value;
+  }
+  *s = in_doubles;
+  return NUM_SHAPES;
+}
+
+gemm_config_t gemm_get_config (void)
+{
+  return config;
+}
+
+bool gemm_set_config (const gemm_config_t* cfg)
+{
+  const int L = lanes<double>::value;
+  if (cfg->nr % L != 0 || !find_kernel<double, double> (cfg->mr, cfg->nr / L)
+      || cfg->mc <= 0 || cfg->kc <= 0 || cfg->nc <= 0)
+    return false;
+  config = *cfg;
+  config.mc = (config.mc + config.mr - 1) / config.mr * config.mr;
+  config.nc = (config.nc + config.nr - 1) / config.nr * config.nr;
+  return true;
+}
+
+bool gemm_load_config (const char* filename)
+{
+  FILE* fp = fopen (filename, "r");
+  if (!fp)
+    return false;
+  gemm_config_t cfg = config;
+  char line[256], key[32];
+  int value;
+  while (fgets (line, sizeof (line), fp)) {
+    if (line[0] == '#' || sscanf (line, "%31s %d", key, &value) != 2)
+      continue;
+    if (!strcmp (key, "mr")) cfg.mr = value;
+    else if (!strcmp (key, "nr")) cfg.nr = value;
+    else if (!strcmp (key, "mc")) cfg.mc = value;
+    else if (!strcmp (key, "kc")) cfg.kc = value;
+    else if (!strcmp (key, "nc")) cfg.nc = value;
+  }
+  fclose (fp);
+  return gemm_set_config (&cfg);
+}
+
+bool gemm_save_config (const char* filename, const char* comment)
+{
+  FILE* fp = fopen (filename, "w");
+  if (!fp)
+    return false;
+  if (comment)
+    fprintf (fp, "# %s\n", comment);
+  fprintf (fp, "mr %d\nnr %d\nmc %d\nkc %d\nnc %d\n", config.mr, config.nr,
+           config.mc, config.kc, config.nc);
+  return fclose (fp) == 0;
+}
+
+/**
+ *  The macro-kernel: C (mc x nc, leading dimension ldc) += packed A
+ *  block * packed B panel, in mr x nr tiles. Partial tiles at the edges
+ *  are computed into a scratch tile and only their valid part is added
+ *  to C.
+ */
+template <typename T, typename Acc>
+static void macro_kernel (typename kernel_fn<T, Acc>::type kernel, int mr,
+                          int nr, int mc, int nc, int kc, const Acc* Ap,
+                          const T* Bp, Acc* C, int ldc)
+{
+  Acc edge[MAX_TILE];
+
+  for (int j = 0; j < nc; j += nr) {
+    int cols = nc - j < nr ? nc - j : nr;
+    const T* b = Bp + (size_t)j * kc;
+    for (int i = 0; i < mc; i += mr) {
+      int rows = mc - i < mr ? mc - i : mr;
+      const Acc* a = Ap + (size_t)i * kc;
+      Acc* c = C + (size_t)i * ldc + j;
+      if (rows == mr && cols == nr) {
+        kernel (kc, a, b, c, ldc);
+      } else {
+        memset (edge, 0, sizeof (edge));
+        kernel (kc, a, b, edge, nr);
+        for (int r = 0; r < rows; ++r)
+          for (int s = 0; s < cols; ++s)
+            c[(size_t)r * ldc + s] += edge[r * nr + s];
+      }
+    }
+  }
+}
+
+#if defined (__linux__)
+/** The CPUs the process may use, as found before any thread was pinned. */
+static cpu_set_t allowed_cpus;
+static int allowed_count = 0;
+
+/** Set once a pool thread has been pinned; pool threads outlive a call. */
+static int pinned = 0;
+#pragma omp threadprivate(pinned)
+#endif
+
+/**
+ *  Whether gemm() should pin a team of 'threads': not for one thread, nor
+ *  when the OpenMP runtime already binds threads (OMP_PROC_BIND), nor
+ *  inside a parallel region, where every nested team's thread is number
+ *  0 and all would land on the same CPU.
+ */
+static bool pinning (int threads)
+{
+#if defined (__linux__)
+  if (allowed_count == 0)
+    allowed_count = sched_getaffinity (0, sizeof (allowed_cpus), &allowed_cpus)
+      == 0 ? CPU_COUNT (&allowed_cpus) : -1;
+  return threads > 1 && allowed_count > 0 && !omp_in_parallel ()
+    && omp_get_proc_bind () == omp_proc_bind_false;
+#else
+  return false;
+#endif
+}
+
+/**
+ *  Binds the calling team thread to one of the process's CPUs, picked by
+ *  thread number, so that it keeps its packed A block in its own core's
+ *  L2. Pool threads are pinned the first time only; the master is the
+ *  caller's own thread, which gemm() hands back its mask afterwards.
+ */
+static void pin_thread (void)
+{
+#if defined (__linux__)
+  int me = omp_get_thread_num ();
+  if (me != 0 && pinned)
+    return;
+  int want = me % allowed_count;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET (cpu, &allowed_cpus) && want-- == 0) {
+      cpu_set_t mine;
+      CPU_ZERO (&mine);
+      CPU_SET (cpu, &mine);
+      if (sched_setaffinity (0, sizeof (mine), &mine) == 0 && me != 0)
+        pinned = 1;
+      return;
+    }
+  }
+#endif
+}
+
+template <typename T, typename Acc>
+void mm_blis (Acc* C, const T* A, const T* B, int N, int K, int M)
+{
+  gemm (N, K, M, A, K, B, M, C, M);
+}
+
+size_t gemm_workspace (int threads)
+{
+  return 64 + workspace_bytes (config, threads);
+}
+
+template <typename T, typename Acc>
+void gemm (int N, int K, int M, const T* A, int lda, const T* B, int ldb,
+           Acc* C, int ldc)
+{
+  int threads = omp_in_parallel () ? 1 : omp_get_max_threads ();
+  size_t bytes = workspace_bytes (config, threads);
+  gemm_ws (N, K, M, A, lda, B, ldb, C, ldc, own_workspace (bytes), bytes);
+}
+
+template <typename T, typename Acc>
+void gemm_ws (int N, int K, int M, const T* A, int lda, const T* B, int ldb,
+              Acc* C, int ldc, void* work, size_t work_size)
+{
+  assert (C && A && B && N >= 0 && K >= 0 && M >= 0);
+  assert (lda >= K && ldb >= M && ldc >= M);
+
+  /* The configured tile, its vectors widened to this type's lanes */
+  const gemm_config_t cfg = config;
+  const int mr = cfg.mr, nv = cfg.nr / lanes<double>::value;
+  const int nr = nv * lanes<Acc>::value;
+  const int nc_max = (cfg.nc + nr - 1) / nr * nr;
+  const typename kernel_fn<T, Acc>::type kernel = find_kernel<T, Acc> (mr, nv);
+  assert (kernel && mr * nr <= MAX_TILE);
+
+  /* Line the space up, and use no more threads than it has A blocks for */
+  char* Bw = (char *)(((uintptr_t)work + 63) & ~(uintptr_t)63);
+  size_t room = work_size - (Bw - (char *)work);
+  assert (work && work_size >= (size_t)(Bw - (char *)work)
+          && room >= workspace_bytes (cfg, 1));
+  int threads = omp_in_parallel () ? 1 : omp_get_max_threads ();
+  size_t fit = (room - panel_bytes (cfg)) / block_bytes (cfg);
+  if ((size_t)threads > fit)
+    threads = (int)fit;
+
+  /* Shrink MC when N is too short to give every thread a block */
+  int mc_max = (N + threads - 1) / threads;
+  mc_max = (mc_max + mr - 1) / mr * mr;
+  if (mc_max > cfg.mc || mc_max == 0)
+    mc_max = cfg.mc;
+
+  T* Bp = (T *)Bw;
+  char* Aw = Bw + panel_bytes (cfg);
+
+  /* Pinning moves the calling thread too: keep its mask to put back */
+  bool pin = pinning (threads);
+#if defined (__linux__)
+  cpu_set_t caller_cpus;
+  if (pin && sched_getaffinity (0, sizeof (caller_cpus), &caller_cpus) != 0)
+    pin = false;
+#endif
+
+#pragma omp parallel num_threads(threads)
+  {
+    if (pin)
+      pin_thread ();
+    Acc* Ap = (Acc *)(Aw + omp_get_thread_num () * block_bytes (cfg));
+
+    for (int jc = 0; jc < M; jc += nc_max) {
+      int nc = M - jc < nc_max ? M - jc : nc_max;
+      for (int pc = 0; pc < K; pc += cfg.kc) {
+        int kc = K - pc < cfg.kc ? K - pc : cfg.kc;
+
+        /* All threads pack the shared panel of B, a sliver each */
+#pragma omp for schedule(static)
+        for (int j = 0; j < nc; j += nr)
+          pack_B (Bp + (size_t)j * kc, B + (size_t)pc * ldb + jc + j, ldb, kc,
+                  nc - j < nr ? nc - j : nr, nr);
+
+        /* Then each takes whole blocks of A, packed privately */
+#pragma omp for schedule(dynamic)
+        for (int ic = 0; ic < N; ic += mc_max) {
+          int mc = N - ic < mc_max ? N - ic : mc_max;
+          pack_A (Ap, A + (size_t)ic * lda + pc, lda, mc, kc, mr);
+          macro_kernel<T, Acc> (kernel, mr, nr, mc, nc, kc, Ap, Bp,
+                                C + (size_t)ic * ldc + jc, ldc);
+        }
+      }
+    }
+  }
+
+#if defined (__linux__)
+  if (pin)
+    sched_setaffinity (0, sizeof (caller_cpus), &caller_cpus);
+#endif
+}
+
+/* The element types there are kernels for */
+#define GEMM_INSTANTIATE(T, Acc) \
+  template void mm_blis<T, Acc> (Acc*, const T*, const T*, int, int, int); \
+  template void gemm<T, Acc> (int, int, int, const T*, int, const T*, int, \
+                              Acc*, int); \
+  template void gemm_ws<T, Acc> (int, int, int, const T*, int, const T*, int, \
+                                 Acc*, int, void*, size_t);
+GEMM_INSTANTIATE (double, double)
+GEMM_INSTANTIATE (float, float)
+GEMM_INSTANTIATE (float, double)
+
+// eof
@@ -0,0 +1,125 @@
+/**
+ *  \file gemm.hh
+ *  \brief Packed, register-blocked matrix multiply
+ *
+ *  A BLIS-style GEMM: C is computed in MR x NR micro-tiles held in
+ *  registers, from copies of A and B packed so that the micro-kernel
+ *  reads both with unit stride. Three levels of blocking keep each
+ *  packed operand in the cache that feeds it:
+ *
+ *    - an MR x KC sliver of A and a KC x NR sliver of B stream through
+ *      L1 for each micro-tile,
+ *    - the MC x KC block of packed A stays in L2 across a whole row of
+ *      micro-tiles,
+ *    - the KC x NC panel of packed B stays in L3 across all of A's
+ *      blocks.
+ *
+ *  With OpenMP the threads share each packed panel of B, packing a
+ *  sliver of it each, then split the blocks of A (the ic loop) between
+ *  them, each packing its own. Threads are pinned to CPUs unless
+ *  OMP_PROC_BIND already does so, pool threads once for good and the
+ *  calling thread only for the call; calls from inside a parallel region
+ *  pin nothing.
+ *
+ *  The micro-tile shape and the blocking are set at run time (see
+ *  gemm_config_t; tune.hh searches for good values). The micro-kernels
+ *  use AVX2 and FMA when compiled for them (e.g. with -march=native);
+ *  otherwise plain C kernels of the same shapes are used.
+ */
+
+#if !defined (INC_GEMM_HH)
+#define INC_GEMM_HH
+
+#include <stddef.h>
+
+/** Default micro-tile: 6 rows of two 4-double vectors, 12 ymm registers. */
+#define GEMM_MR 6
+#define GEMM_NR 8
+
+/** Default cache blocking. */
+#define GEMM_MC 96
+#define GEMM_KC 256
+#define GEMM_NC 4096
+
+/** Where tuned settings are kept between runs. */
+#define GEMM_CONFIG_FILE "gemm.cfg"
+
+/** Micro-tile shape and blocking, in elements. */
+struct gemm_config_t {
+  int mr, nr;       /*!< Double micro-tile; one of gemm_tile_shapes() */
+  int mc, kc, nc;   /*!< Cache blocks; MC is a multiple of MR, NC of NR */
+};
+
+/**
+ *  The micro-tile shapes there are kernels for, as {mr, nr} pairs.
+ *  Returns how many.
+ */
+int gemm_tile_shapes (const int (**shapes)[2]);
+
+/** The settings mm_blis() uses. */
+gemm_config_t gemm_get_config (void);
+
+/**
+ *  Makes 'cfg' current, rounding MC up to a multiple of MR and NC to a
+ *  multiple of NR. Returns false, changing nothing, if there is no kernel
+ *  for the tile shape or a block size is not positive.
+ */
+bool gemm_set_config (const gemm_config_t* cfg);
+
+/**
+ *  Reads settings written by gemm_save_config() and makes them current.
+ *  Returns false, changing nothing, if the file is missing or invalid.
+ */
+bool gemm_load_config (const char* filename);
+
+/** Writes the current settings, with 'comment' on a '#' line if not NULL. */
+bool gemm_save_config (const char* filename, const char* comment);
+
+/**
+ *  C += A * B, with A N x K, B K x M and C N x M, all row-major and
+ *  densely stored. Any sizes; the packed copies are zero-padded to
+ *  whole micro-tiles. Runs on omp_get_max_threads() threads.
+ *
+ *  A and B hold T, C holds Acc, and the sums are formed in Acc. The
+ *  combinations built (in gemm.cc) are
+ *
+ *    - double, double,
+ *    - float, float: 8 lanes per vector, so twice the rate of double,
+ *    - float, double: float inputs, half the memory traffic of double,
+ *      accumulated and returned in double.
+ *
+ *  Each has its own micro-kernels. A float tile has as many vectors as
+ *  the configured double one, so twice as many columns.
+ */
+template <typename T, typename Acc>
+void mm_blis (Acc* C, const T* A, const T* B, int N, int K, int M);
+
+/**
+ *  As mm_blis(), on row-major submatrices with leading dimensions lda,
+ *  ldb and ldc. Called from inside a parallel region it runs on the
+ *  calling thread alone. The packed copies go in space each calling
+ *  thread keeps for later calls, so only a thread's first call, or one
+ *  needing more room than before, allocates.
+ */
+template <typename T, typename Acc>
+void gemm (int N, int K, int M, const T* A, int lda, const T* B, int ldb,
+           Acc* C, int ldc);
+
+/**
+ *  Bytes of packing space gemm_ws() needs to run on 'threads' threads
+ *  with the current settings, for any of the element types.
+ */
+size_t gemm_workspace (int threads);
+
+/**
+ *  As gemm(), packing into the work_size bytes at 'work' rather than into
+ *  space of its own, for callers that lay out their memory up front. It
+ *  runs on no more threads than gemm_workspace() says the space is for.
+ */
+template <typename T, typename Acc>
+void gemm_ws (int N, int K, int M, const T* A, int lda, const T* B, int ldb,
+              Acc* C, int ldc, void* work, size_t work_size);
+
+#endif
+
+// eof
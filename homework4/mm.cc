@@ -1 +1 @@
-#include <stdio.h>#include <stdlib.h>#include <time.h>#include <assert.h>#include <smmintrin.h>#include "timer.c"#define N_ 4096#define K_ 4096#define M_ 4096#define BLOCk_SIZE 16typedef double dtype;void verify(dtype *C, dtype *C_ans, int N, int M){  int i, cnt;  cnt = 0;  for(i = 0; i < N * M; i++) {    if(abs (C[i] - C_ans[i]) > 1e-6) cnt++;  }  if(cnt != 0) printf("ERROR\n"); else printf("SUCCESS\n");}void mm_serial (dtype *C, dtype *A, dtype *B, int N, int K, int M){  int i, j, k;  for(int i = 0; i < N; i++) {    for(int j = 0; j < M; j++) {      for(int k = 0; k < K; k++) {        C[i * M + j] += A[i * K + k] * B[k * M + j];      }    }  }}void mm_cache (dtype *C, dtype *A, dtype *B, int N, int K, int M){  int i, j, k;  dtype temp;  for(int i = 0; i < N; i++) {    for(int j = 0; j < M; j++) {      temp = C[i * M + j];      for(int k = 0; k < K; k++) {        temp += A[i * K + k] * B[k * M + j];      }      C[i * M + j] = temp;    }  }}void mm_vector (dtype *C, dtype *A, dtype *B, int N){  int i, j, k;  __m128d a_vec, b_vec, mult_vec;      double z[2] = {0.0, 0.0};  double c[2];  for(int i = 0; i < N; i++) {    for(int j = 0; j < N; j++) {      mult_vec = _mm_load_pd(z);      for(int k = 0; k < N; k += 2) {        a_vec = _mm_load_pd(A + (i * N) + k);        b_vec = _mm_load_pd(B + (j * N) + k);        mult_vec = _mm_add_pd(_mm_mul_pd(a_vec, b_vec), mult_vec);      }      _mm_store_pd(c, mult_vec);      C[i * N + j] += c[0] + c[1];    }  }}void mm_cb (dtype *C, dtype *A, dtype *B, int N, int K, int M){  int i,j,k;  int row, column;  dtype *A_temp = (dtype*) malloc (BLOCk_SIZE * BLOCk_SIZE * sizeof (dtype));  dtype *B_temp = (dtype*) malloc (BLOCk_SIZE * BLOCk_SIZE * sizeof (dtype));  dtype *C_temp = (dtype*) malloc (BLOCk_SIZE * BLOCk_SIZE * sizeof (dtype));  for(int i = 0; i < N; i+=BLOCk_SIZE)  {    for(int j = 0; j < M; j+=BLOCk_SIZE)    {      for(row = 0; row < BLOCk_SIZE; row++)      {        for(column = 0; column < BLOCk_SIZE; column++)        {          C_temp[row*BLOCk_SIZE + column] = C[(i+row)*M + j + column];        }      }      for(int k = 0; k < K; k+=BLOCk_SIZE)      {        for(row = 0; row < BLOCk_SIZE; row++)        {          for(column = 0; column < BLOCk_SIZE; column++)          {            A_temp[row*BLOCk_SIZE + column] = A[(i+row)*K + k + column];          }        }        for(row = 0; row < BLOCk_SIZE; row++)        {          for(column = 0; column < BLOCk_SIZE; column++)          {            B_temp[row*BLOCk_SIZE + column] = B[(k+row)*M + j + column];          }        }        mm_cache(C_temp, A_temp, B_temp, BLOCk_SIZE, BLOCk_SIZE, BLOCk_SIZE);      }      for(row = 0; row < BLOCk_SIZE; row++)      {        for(column = 0; column < BLOCk_SIZE; column++)        {          C[(i+row)*M + j + column] = C_temp[row*BLOCk_SIZE + column];        }      }    }  }}void mm_sv (dtype *C, dtype *A, dtype *B, int N, int K, int M){  int i,j,k;  int row, column;  dtype *A_temp = (dtype*) malloc (BLOCk_SIZE * BLOCk_SIZE * sizeof (dtype));  dtype *B_temp = (dtype*) malloc (BLOCk_SIZE * BLOCk_SIZE * sizeof (dtype));  dtype *C_temp = (dtype*) malloc (BLOCk_SIZE * BLOCk_SIZE * sizeof (dtype));  for(int i = 0; i < N; i+=BLOCk_SIZE)  {    for(int j = 0; j < M; j+=BLOCk_SIZE)    {      for(row = 0; row < BLOCk_SIZE; row++)      {        for(column = 0; column < BLOCk_SIZE; column++)        {          C_temp[row*BLOCk_SIZE + column] = C[(i+row)*M + j + column];        }      }      for(int k = 0; k < K; k+=BLOCk_SIZE)      {        for(row = 0; row < BLOCk_SIZE; row++)        {          for(column = 0; column < BLOCk_SIZE; column++)          {            A_temp[row*BLOCk_SIZE + column] = A[(i+row)*K + k + column];          }        }        for(row = 0; row < BLOCk_SIZE; row++)        {          for(column = 0; column < BLOCk_SIZE; column++)          {            B_temp[column*BLOCk_SIZE + row] = B[(k+row)*M + j + column];          }        }        mm_vector(C_temp, A_temp, B_temp, BLOCk_SIZE);      }      for(row = 0; row < BLOCk_SIZE; row++)      {        for(column = 0; column < BLOCk_SIZE; column++)        {          C[(i+row)*M + j + column] = C_temp[row*BLOCk_SIZE + column];        }      }    }  }}int main(int argc, char** argv){  int i, j, k;  int N, K, M;  if(argc == 4) {    N = atoi (argv[1]);    K = atoi (argv[2]);    M = atoi (argv[3]);    printf("N: %d K: %d M: %d B_Size: %d\n", N, K, M, BLOCk_SIZE);  } else {    N = N_;    K = K_;    M = M_;    printf("N: %d K: %d M: %d\n", N, K, M);  }  dtype *A = (dtype*) malloc (N * K * sizeof (dtype));  dtype *B = (dtype*) malloc (K * M * sizeof (dtype));  dtype *C = (dtype*) malloc (N * M * sizeof (dtype));  dtype *C_cb = (dtype*) malloc (N * M * sizeof (dtype));  dtype *C_sv = (dtype*) malloc (N * M * sizeof (dtype));  assert (A && B && C);  /* initialize A, B, C */  srand48 (time (NULL));  for(i = 0; i < N; i++) {    for(j = 0; j < K; j++) {      A[i * K + j] = drand48 ();    }  }  for(i = 0; i < K; i++) {    for(j = 0; j < M; j++) {      B[i * M + j] = drand48 ();    }  }  bzero(C, N * M * sizeof (dtype));  bzero(C_cb, N * M * sizeof (dtype));  bzero(C_sv, N * M * sizeof (dtype));  stopwatch_init ();  struct stopwatch_t* timer = stopwatch_create ();  assert (timer);  long double t;  printf("Naive matrix multiply\n");  stopwatch_start (timer);  /* do C += A * B */  mm_serial (C, A, B, N, K, M);  t = stopwatch_stop (timer);  printf("Done\n");  printf("time for naive implementation: %Lg seconds\n\n", t);  printf("Cache-blocked matrix multiply\n");  stopwatch_start (timer);  /* do C += A * B */  mm_cb (C_cb, A, B, N, K, M);  t = stopwatch_stop (timer);  printf("Done\n");  printf("time for cache-blocked implementation: %Lg seconds\n", t);  /* verify answer */  verify (C_cb, C, N, M);  printf("SIMD-vectorized Cache-blocked matrix multiply\n");  stopwatch_start (timer);  /* do C += A * B */  mm_sv (C_sv, A, B, N, K, M);  t = stopwatch_stop (timer);  printf("Done\n");  printf("time for SIMD-vectorized cache-blocked implementation: %Lg seconds\n", t);  /* verify answer */  verify (C_sv, C, N, M);  return 0;}
\ No newline at end of file
+/** *  \file mm.cc *  \brief Matrix multiply variants and a benchmark harness for them * *  Build: g++ -O3 -march=native -fopenmp -o mm mm.cc gemm.cc tune.cc strassen.cc roofline.cc batch.cc morton.cc sparse.cc *  usage: ./mm [-k kernels] [-s sizes] [-t threads] [-r reps] *              [-v sample|full|naive|none] [-c crossover] [-z Morton tile] *              [-b bandwidth file] *         ./mm N K M [Strassen crossover] *         ./mm tune [size [sb output]] *         ./mm batch [n [count]] *         ./mm sparse [-k vectors] [-r reps] [-C slice] [-S sigma] [-b bandwidth file] *                     [file.mtx | rows [nonzeros per row]] * *  Runs the chosen kernels (default: all but the naive one) at each size *  and thread count, and reports for each its time, GFLOP/s, arithmetic *  intensity over the compulsory traffic, and its place on the roofline: *  the FMA peak is measured at startup, and the bandwidth is read from *  the output of 'sb -b' if given. Results are checked, by default, on *  sampled entries against long double dot products; -v full compares *  every entry with the packed multiply (itself checked by sampling), and *  -v naive with the naive loop, which takes minutes at 4096. * *  The morton kernel (morton.hh) converts to and from its tiled layout *  inside the timing. Against cache, the blocked row-major kernel, it *  shows what power-of-two sizes (e.g. -s 1000,1024,2000,2048) cost *  row-major storage in TLB and cache-set conflicts. * *  The tune mode searches for the packed multiply's micro-tile and *  blocking, seeded from the cache sizes in sb.cc's output if given, and *  saves them to gemm.cfg, which later runs load. The batch mode times *  batches of small multiplies (batch.hh), by default at each size with *  a fixed kernel, against a gemm() call per product. The sparse mode *  times SpMV and SpMM with k vectors (sparse.hh) in CSR and SELL-C-sigma *  on a Matrix Market file, or by default on a random matrix, reporting *  GFLOP/s and the effective bandwidth, which bounds them, as a share of *  what sb -b measured. */#include <stdio.h>#include <stdlib.h>#include <time.h>#include <math.h>#include <assert.h>#include <limits.h>#include <smmintrin.h>#include <string.h>#include <unistd.h>#include <omp.h>#include "timer.c"#include "gemm.hh"#include "tune.hh"#include "strassen.hh"#include "roofline.hh"#include "batch.hh"#include "morton.hh"#include "sparse.hh"#define N_ 4096#define K_ 4096#define M_ 4096#define BLOCk_SIZE 16typedef double dtype;void verify(dtype *C, dtype *C_ans, int N, int M){  int i, cnt;  dtype err, max_err;  cnt = 0;  max_err = 0;  for(i = 0; i < N * M; i++) {    err = fabs (C[i] - C_ans[i]);    if(err > 1e-6) cnt++;    if(err > max_err) max_err = err;  }  if(cnt != 0) printf("ERROR"); else printf("SUCCESS");  printf(" (max error %g)\n", max_err);}/** Rate of an N x K x M multiply taking t seconds, in GFLOP/s. */double gflops(int N, int K, int M, long double t){  return 2.0 * N * K * M / t * 1e-9;}/* * As verify(), for results from float inputs or float arithmetic, which * cannot match the double reference to 1e-6: checks the error relative * to the reference entry against 'tol' instead. */void verify_relative(dtype *C, dtype *C_ans, int N, int M, dtype tol){  int i, cnt;  dtype err, max_err;  cnt = 0;  max_err = 0;  for(i = 0; i < N * M; i++) {    err = fabs (C[i] - C_ans[i]) / (fabs (C_ans[i]) > 1 ? fabs (C_ans[i]) : 1);    if(err > tol) cnt++;    if(err > max_err) max_err = err;  }  if(cnt != 0) printf("ERROR"); else printf("SUCCESS");  printf(" (max relative error %g)\n", max_err);}void mm_serial (dtype *C, dtype *A, dtype *B, int N, int K, int M){  int i, j, k;  for(int i = 0; i < N; i++) {    for(int j = 0; j < M; j++) {      for(int k = 0; k < K; k++) {        C[i * M + j] += A[i * K + k] * B[k * M + j];      }    }  }}void mm_cache (dtype *C, dtype *A, dtype *B, int N, int K, int M){  int i, j, k;  dtype temp;  for(int i = 0; i < N; i++) {    for(int j = 0; j < M; j++) {      temp = C[i * M + j];      for(int k = 0; k < K; k++) {        temp += A[i * K + k] * B[k * M + j];      }      C[i * M + j] = temp;    }  }}/* * C += A * B^T with A N x K and B stored transposed, M x K, so both are * read along rows. Loads are unaligned, and an odd K ends with a load of * one element into the low lane (the high lane is zero). */void mm_vector (dtype *C, dtype *A, dtype *B, int N, int K, int M){  __m128d a_vec, b_vec, mult_vec;  double c[2];  for(int i = 0; i < N; i++) {    for(int j = 0; j < M; j++) {      mult_vec = _mm_setzero_pd();      int k;      for(k = 0; k + 2 <= K; k += 2) {        a_vec = _mm_loadu_pd(A + (i * K) + k);        b_vec = _mm_loadu_pd(B + (j * K) + k);        mult_vec = _mm_add_pd(_mm_mul_pd(a_vec, b_vec), mult_vec);      }      if(k < K) {        a_vec = _mm_load_sd(A + (i * K) + k);        b_vec = _mm_load_sd(B + (j * K) + k);        mult_vec = _mm_add_pd(_mm_mul_pd(a_vec, b_vec), mult_vec);      }      _mm_storeu_pd(c, mult_vec);      C[i * M + j] += c[0] + c[1];    }  }}/* * Copies the rows x cols block at src (leading dimension ld) into the top * left of a BLOCk_SIZE x BLOCk_SIZE tile, zero-filling the rest, so edge * blocks go through the same fixed-size kernel as interior ones. With * 'transpose' the tile holds the block's transpose. */void pack_tile (dtype *tile, dtype *src, int ld, int rows, int cols, int transpose){  int row, column;  if(rows < BLOCk_SIZE || cols < BLOCk_SIZE)    bzero(tile, BLOCk_SIZE * BLOCk_SIZE * sizeof (dtype));  for(row = 0; row < rows; row++)  {    for(column = 0; column < cols; column++)    {      if(transpose)        tile[column*BLOCk_SIZE + row] = src[row*ld + column];      else        tile[row*BLOCk_SIZE + column] = src[row*ld + column];    }  }}/* Copies the top left rows x cols of a tile back to dst (leading dimension ld). */void unpack_tile (dtype *dst, dtype *tile, int ld, int rows, int cols){  int row, column;  for(row = 0; row < rows; row++)  {    for(column = 0; column < cols; column++)    {      dst[row*ld + column] = tile[row*BLOCk_SIZE + column];    }  }}/* Size of the block starting at i of a dimension n long. */int block_extent (int i, int n){  return n - i < BLOCk_SIZE ? n - i : BLOCk_SIZE;}void mm_cb (dtype *C, dtype *A, dtype *B, int N, int K, int M){  dtype *A_temp = (dtype*) malloc (BLOCk_SIZE * BLOCk_SIZE * sizeof (dtype));  dtype *B_temp = (dtype*) malloc (BLOCk_SIZE * BLOCk_SIZE * sizeof (dtype));  dtype *C_temp = (dtype*) malloc (BLOCk_SIZE * BLOCk_SIZE * sizeof (dtype));  assert (A_temp && B_temp && C_temp);  for(int i = 0; i < N; i+=BLOCk_SIZE)  {    int rows = block_extent (i, N);    for(int j = 0; j < M; j+=BLOCk_SIZE)    {      int cols = block_extent (j, M);      pack_tile (C_temp, C + i*M + j, M, rows, cols, 0);      for(int k = 0; k < K; k+=BLOCk_SIZE)      {        int depth = block_extent (k, K);        pack_tile (A_temp, A + i*K + k, K, rows, depth, 0);        pack_tile (B_temp, B + k*M + j, M, depth, cols, 0);        mm_cache(C_temp, A_temp, B_temp, BLOCk_SIZE, BLOCk_SIZE, BLOCk_SIZE);      }      unpack_tile (C + i*M + j, C_temp, M, rows, cols);    }  }  free (A_temp);  free (B_temp);  free (C_temp);}void mm_sv (dtype *C, dtype *A, dtype *B, int N, int K, int M){  dtype *A_temp = (dtype*) malloc (BLOCk_SIZE * BLOCk_SIZE * sizeof (dtype));  dtype *B_temp = (dtype*) malloc (BLOCk_SIZE * BLOCk_SIZE * sizeof (dtype));  dtype *C_temp = (dtype*) malloc (BLOCk_SIZE * BLOCk_SIZE * sizeof (dtype));  assert (A_temp && B_temp && C_temp);  for(int i = 0; i < N; i+=BLOCk_SIZE)  {    int rows = block_extent (i, N);    for(int j = 0; j < M; j+=BLOCk_SIZE)    {      int cols = block_extent (j, M);      pack_tile (C_temp, C + i*M + j, M, rows, cols, 0);      for(int k = 0; k < K; k+=BLOCk_SIZE)      {        int depth = block_extent (k, K);        pack_tile (A_temp, A + i*K + k, K, rows, depth, 0);        pack_tile (B_temp, B + k*M + j, M, depth, cols, 1);        mm_vector(C_temp, A_temp, B_temp, BLOCk_SIZE, BLOCk_SIZE, BLOCk_SIZE);      }      unpack_tile (C + i*M + j, C_temp, M, rows, cols);    }  }  free (A_temp);  free (B_temp);  free (C_temp);}/* ------------------------------------------------------------------ *//* Benchmark harness                                                   *//* ------------------------------------------------------------------ */#define SAMPLES 256 /* entries checked by the sampled verification */enum { PREC_DOUBLE, PREC_FLOAT, PREC_MIXED };enum { VERIFY_SAMPLE, VERIFY_FULL, VERIFY_NAIVE, VERIFY_NONE };/* One problem size: the inputs, in double and rounded to float */struct problem_t {  int N, K, M;  dtype *A, *B;  float *A_f, *B_f;  int crossover;  strassen_t strassen;  int tile;  morton_t A_z, B_z, C_z;};/* * A multiply to benchmark; results go to C, or to C_f for PREC_FLOAT. * setup and cleanup, if given, run untimed around each thread count. */struct variant_t {  const char *name;  const char *desc;  int prec;  int square_only;  void (*run)(problem_t *p, dtype *C, float *C_f);  void (*setup)(problem_t *p, int threads);  void (*cleanup)(problem_t *p);};void run_naive(problem_t *p, dtype *C, float *) { mm_serial (C, p->A, p->B, p->N, p->K, p->M); }void run_cache(problem_t *p, dtype *C, float *) { mm_cb (C, p->A, p->B, p->N, p->K, p->M); }void run_simd(problem_t *p, dtype *C, float *) { mm_sv (C, p->A, p->B, p->N, p->K, p->M); }void run_blis(problem_t *p, dtype *C, float *) { mm_blis (C, p->A, p->B, p->N, p->K, p->M); }void run_sgemm(problem_t *p, dtype *, float *C_f) { mm_blis (C_f, p->A_f, p->B_f, p->N, p->K, p->M); }void run_mixed(problem_t *p, dtype *C, float *) { mm_blis (C, p->A_f, p->B_f, p->N, p->K, p->M); }void run_strassen(problem_t *p, dtype *C, float *) { mm_strassen (&p->strassen, C, p->A, p->B); }void setup_strassen(problem_t *p, int threads) { strassen_init (&p->strassen, p->N, p->crossover, threads > 1 ? 1 : 0); }void cleanup_strassen(problem_t *p) { strassen_free (&p->strassen); }/* Timed with the conversions to and from row-major, which are O(n^2) */void run_morton(problem_t *p, dtype *C, float *){  morton_from_rowmajor (&p->A_z, p->A, p->K);  morton_from_rowmajor (&p->B_z, p->B, p->M);  morton_from_rowmajor (&p->C_z, C, p->M);  mm_morton (&p->C_z, &p->A_z, &p->B_z);  morton_to_rowmajor (&p->C_z, C, p->M);}void setup_morton(problem_t *p, int){  int n = p->N > p->K ? p->N : p->K;  int levels = morton_levels (n > p->M ? n : p->M, p->tile);  morton_init (&p->A_z, p->N, p->K, p->tile, levels);  morton_init (&p->B_z, p->K, p->M, p->tile, levels);  morton_init (&p->C_z, p->N, p->M, p->tile, levels);}void cleanup_morton(problem_t *p){  morton_free (&p->A_z);  morton_free (&p->B_z);  morton_free (&p->C_z);}variant_t variants[] = {  { "naive", "naive triple loop", PREC_DOUBLE, 0, run_naive, NULL, NULL },  { "cache", "cache-blocked", PREC_DOUBLE, 0, run_cache, NULL, NULL },  { "simd", "SIMD-vectorized cache-blocked", PREC_DOUBLE, 0, run_simd, NULL, NULL },  { "blis", "packed register-blocked", PREC_DOUBLE, 0, run_blis, NULL, NULL },  { "sgemm", "single-precision packed", PREC_FLOAT, 0, run_sgemm, NULL, NULL },  { "mixed", "float inputs, double sums, packed", PREC_MIXED, 0, run_mixed, NULL, NULL },  { "strassen", "Strassen-Winograd", PREC_DOUBLE, 1, run_strassen, setup_strassen, cleanup_strassen },  { "morton", "recursive on Morton-ordered tiles", PREC_DOUBLE, 0, run_morton, setup_morton, cleanup_morton },};#define NUM_VARIANTS ((int)(sizeof (variants) / sizeof (variants[0])))#define DEFAULT_VARIANTS "cache,simd,blis,sgemm,mixed,strassen,morton"/* Whether 'name' is in the comma-separated 'list' ("all" matches anything) */int in_list(const char *list, const char *name){  size_t n = strlen (name);  if(strcmp (list, "all") == 0) return 1;  for(const char *s = list; s; s = strchr (s, ',')) {    if(*s == ',') s++;    if(strncmp (s, name, n) == 0 && (s[n] == ',' || s[n] == '\0')) return 1;  }  return 0;}/* * Compares SAMPLES random entries of the result with dot products formed * in long double from the inputs the kernel was given. Costs O(K) per * entry, so it suits any size. Returns whether all were within 'tol', * relative to the entry. */int verify_sampled(const problem_t *p, int prec, dtype *C, float *C_f, dtype tol){  unsigned int seed = 12345;  dtype max_err = 0;  int cnt = 0;  for(int s = 0; s < SAMPLES; s++) {    int i = rand_r (&seed) % p->N, j = rand_r (&seed) % p->M;    long double ref = 0;    for(int k = 0; k < p->K; k++) {      if(prec == PREC_DOUBLE)        ref += (long double) p->A[i * p->K + k] * p->B[k * p->M + j];      else        ref += (long double) p->A_f[i * p->K + k] * p->B_f[k * p->M + j];    }    dtype got = prec == PREC_FLOAT ? C_f[i * p->M + j] : C[i * p->M + j];    dtype err = fabsl (got - ref) / (fabsl (ref) > 1 ? fabsl (ref) : 1);    if(err > tol) cnt++;    if(err > max_err) max_err = err;  }  if(cnt != 0) printf("ERROR"); else printf("SUCCESS");  printf(" (%d sampled entries, max relative error %g)\n", SAMPLES, max_err);  return cnt == 0;}/* Bytes an N x K x M multiply must move at least: A and B read, C read and written */double compulsory_bytes(int prec, int N, int K, int M){  double in = prec == PREC_DOUBLE ? sizeof (dtype) : sizeof (float);  double out = prec == PREC_FLOAT ? sizeof (float) : sizeof (dtype);  return in * ((double) N * K + (double) K * M) + 2 * out * N * M;}/* Parses "n" or "NxKxM" */int parse_size(const char *s, int *N, int *K, int *M){  if(sscanf (s, "%dx%dx%d", N, K, M) == 3) return *N > 0 && *K > 0 && *M > 0;  if(sscanf (s, "%d", N) == 1) { *K = *M = *N; return *N > 0; }  return 0;}void usage(const char *prog){  fprintf(stderr, "usage: %s [-k kernels] [-s sizes] [-t threads] [-r reps] [-v sample|full|naive|none]\n"          "          [-c crossover] [-z Morton tile] [-b sb bandwidth output]\n"          "       %s N K M [crossover]\n"          "       %s tune [size [sb output]]\n"          "       %s batch [n [count]]\n"          "       %s sparse [-k vectors] [-r reps] [-C slice] [-S sigma] [-b sb bandwidth output]\n"          "                 [file.mtx | rows [nonzeros per row]]\n"          "kernels (comma-separated, or all):", prog, prog, prog, prog, prog);  for(int v = 0; v < NUM_VARIANTS; v++) fprintf(stderr, " %s", variants[v].name);  fprintf(stderr, "\nsizes: comma-separated n or NxKxM; threads: comma-separated counts\n");}int tune_main(int argc, char** argv){  int size = argc >= 3 ? atoi (argv[2]) : 1024;  cache_sizes_t caches;  bool seeded = argc >= 4 && tune_read_sb (argv[3], &caches);  if(argc >= 4 && !seeded) printf("No cache sizes found in %s; using default blocking\n", argv[3]);  if(seeded) printf("Cache sizes from %s: L1 %ld, L2 %ld, L3 %ld bytes\n", argv[3], caches.l1, caches.l2, caches.l3);  double rate = tune_gemm (size, seeded ? &caches : NULL);  char comment[128];  snprintf(comment, sizeof (comment), "%.3f GFLOP/s at %d^3, %d thread(s)", rate, size, omp_get_max_threads ());  gemm_config_t cfg = gemm_get_config ();  printf("Best: %dx%d micro-tile, mc %d, kc %d, nc %d (%s)\n", cfg.mr, cfg.nr, cfg.mc, cfg.kc, cfg.nc, comment);  if(!gemm_save_config (GEMM_CONFIG_FILE, comment)) {    printf("Could not write %s\n", GEMM_CONFIG_FILE);    return 1;  }  printf("Saved to %s\n", GEMM_CONFIG_FILE);  return 0;}#define BATCH_BYTES (48L << 20) /* operands of a default batch */#define BATCH_CHECKED 16        /* products verified per batch *//* * Times batches of n x n x n multiplies: strided, through pointer arrays, * and one gemm() call per product for comparison. Checks BATCH_CHECKED * of the products against mm_serial(). */int batch_main(int argc, char** argv){  static const int default_sizes[] = { 4, 8, 12, 16, 24, 32, 48, 64 };  int num_sizes = argc >= 3 ? 1 : (int)(sizeof (default_sizes) / sizeof (default_sizes[0]));  struct stopwatch_t* timer;  stopwatch_init ();  timer = stopwatch_create ();  assert (timer);  srand48 (time (NULL));  printf("GFLOP/s of batches of n x n x n multiplies\n");  printf("%4s %8s %6s %12s %12s %12s  %s\n", "n", "count", "fixed", "strided", "pointers", "gemm loop", "verification");  for(int s = 0; s < num_sizes; s++) {    int n = argc >= 3 ? atoi (argv[2]) : default_sizes[s];    long nn = (long) n * n;    int count = argc >= 4 ? atoi (argv[3]) : (int) (BATCH_BYTES / (3 * nn * sizeof (dtype)));    assert (n > 0 && count > 0);    dtype *A = (dtype*) malloc (nn * count * sizeof (dtype));    dtype *B = (dtype*) malloc (nn * count * sizeof (dtype));    dtype *C = (dtype*) malloc (nn * count * sizeof (dtype));    const dtype **A_ptr = (const dtype**) malloc (count * sizeof (dtype*));    const dtype **B_ptr = (const dtype**) malloc (count * sizeof (dtype*));    dtype **C_ptr = (dtype**) malloc (count * sizeof (dtype*));    dtype *C_ans = (dtype*) malloc (nn * sizeof (dtype));    assert (A && B && C && A_ptr && B_ptr && C_ptr && C_ans);    for(long i = 0; i < nn * count; i++) {      A[i] = drand48 ();      B[i] = drand48 ();    }    /* The pointer arrays visit the products in a scattered order */    for(int b = 0; b < count; b++) {      long p = (long) b * 7919 % count;      A_ptr[b] = A + p * nn;      B_ptr[b] = B + p * nn;      C_ptr[b] = C + p * nn;    }    long double best[3];    for(int v = 0; v < 3; v++) {      for(int r = 0; r < 3; r++) {        bzero (C, nn * count * sizeof (dtype));        stopwatch_start (timer);        if(v == 0) gemm_batch_strided (n, n, n, A, nn, B, nn, C, nn, count);        else if(v == 1) gemm_batch (n, n, n, A_ptr, B_ptr, C_ptr, count);        else for(int b = 0; b < count; b++) gemm (n, n, n, A + b * nn, n, B + b * nn, n, C + b * nn, n);        long double t = stopwatch_stop (timer);        if(r == 0 || t < best[v]) best[v] = t;      }    }    /* C holds the last run's products, one multiply each */    dtype max_err = 0;    for(int c = 0; c < BATCH_CHECKED; c++) {      long b = lrand48 () % count;      bzero (C_ans, nn * sizeof (dtype));      mm_serial (C_ans, A + b * nn, B + b * nn, n, n, n);      for(long i = 0; i < nn; i++) {        dtype err = fabs (C[b * nn + i] - C_ans[i]) / fabs (C_ans[i]);        if(err > max_err) max_err = err;      }    }    printf("%4d %8d %6s %12.2f %12.2f %12.2f  %s (max relative error %g)\n", n, count,           gemm_batch_fixed (n, n, n) ? "yes" : "no", count * gflops (n, n, n, best[0]),           count * gflops (n, n, n, best[1]), count * gflops (n, n, n, best[2]),           max_err > 1e-12 ? "ERROR" : "SUCCESS", max_err);    free (A);    free (B);    free (C);    free (A_ptr);    free (B_ptr);    free (C_ptr);    free (C_ans);  }  stopwatch_destroy (timer);  return 0;}#define SPARSE_ROWS (1 << 19) /* rows of the default random matrix */#define SPARSE_PER_ROW 16     /* and its mean nonzeros per row *//* Y += A X by the definition, as the reference for the sparse kernels */void spmm_serial(const csr_t *A, const dtype *X, int k, dtype *Y){  for(int i = 0; i < A->rows; i++)    for(long p = A->row_ptr[i]; p < A->row_ptr[i + 1]; p++)      for(int t = 0; t < k; t++)        Y[(size_t) i * k + t] += A->val[p] * X[(size_t) A->col[p] * k + t];}/* Whether 'arg' is all digits, a count rather than a file name; if so, sets *n */bool parse_count(const char *arg, int *n){  char *end;  long value = strtol (arg, &end, 10);  if(end == arg || *end != '\0' || value <= 0 || value > INT_MAX) return false;  *n = (int) value;  return true;}/* * Times SpMV and SpMM in CSR and SELL-C-sigma on a Matrix Market file or * a random matrix, reporting GFLOP/s and the effective bandwidth over * the compulsory traffic, against 'sb -b' output if given. */int sparse_main(int argc, char** argv){  int k = 8, reps = 5, C = SELL_C, sigma = SELL_SIGMA;  const char *bandwidth_file = NULL;  int opt;  bool bad = false;  while((opt = getopt (argc, argv, "k:r:C:S:b:")) != -1) {    switch(opt) {    case 'k': k = atoi (optarg); break;    case 'r': reps = atoi (optarg); break;    case 'C': C = atoi (optarg); break;    case 'S': sigma = atoi (optarg); break;    case 'b': bandwidth_file = optarg; break;    default: bad = true; break;    }  }  if(bad || k <= 0 || reps <= 0 || C <= 0 || C > SELL_C_MAX || sigma <= 0 || (sigma != 1 && sigma % C != 0)) {    fprintf(stderr, "usage: mm sparse [-k vectors] [-r reps] [-C slice] [-S sigma] [-b sb bandwidth output]\n"            "                 [file.mtx | rows [nonzeros per row]]\n"            "       with 1 <= slice <= %d, and sigma 1 or a multiple of slice\n", SELL_C_MAX);    return 1;  }  csr_t A;  int rows = SPARSE_ROWS, per_row = SPARSE_PER_ROW;  if(optind < argc && !parse_count (argv[optind], &rows)) {    if(!csr_read_mm (argv[optind], &A)) return 1;    printf("%s: ", argv[optind]);  } else {    if(optind + 1 < argc && !parse_count (argv[optind + 1], &per_row)) {      fprintf(stderr, "mm sparse: '%s' is not a count of nonzeros per row\n", argv[optind + 1]);      return 1;    }    csr_random (&A, rows, rows, per_row, time (NULL));    printf("random: ");  }  sell_t S;  sell_from_csr (&S, &A, C, sigma);  printf("%d x %d, %ld nonzeros; SELL-%d-%d stores %.3f times as many\n", A.rows, A.cols, A.nnz,         C, sigma, A.nnz > 0 ? (double) S.slice_ptr[S.slices] / A.nnz : 1.0);  double bandwidth = bandwidth_file ? roofline_read_bandwidth (bandwidth_file) : 0;  if(bandwidth_file && bandwidth <= 0) printf("No bandwidth found in %s\n", bandwidth_file);  stopwatch_init ();  struct stopwatch_t* timer = stopwatch_create ();  assert (timer);  srand48 (time (NULL));  dtype *X = (dtype*) malloc ((size_t) A.cols * k * sizeof (dtype));  dtype *Y = (dtype*) malloc ((size_t) A.rows * k * sizeof (dtype));  dtype *Y_ans = (dtype*) malloc ((size_t) A.rows * k * sizeof (dtype));  assert (X && Y && Y_ans);  for(size_t i = 0; i < (size_t) A.cols * k; i++) X[i] = drand48 ();  printf("%-10s %3s %10s %10s %8s %8s  %s\n", "kernel", "k", "seconds", "GFLOP/s", "GB/s", "%sb", "verification");  for(int v = 0; v < 4; v++) {    int sell = v % 2, n = v < 2 ? 1 : k;    const char *name[] = { "spmv-csr", "spmv-sell", "spmm-csr", "spmm-sell" };    bzero (Y_ans, (size_t) A.rows * n * sizeof (dtype));    spmm_serial (&A, X, n, Y_ans);    long double t, best = 0;    for(int r = 0; r < reps; r++) {      bzero (Y, (size_t) A.rows * n * sizeof (dtype));      stopwatch_start (timer);      /* do Y += A * X */      if(n == 1 && !sell) spmv_csr (&A, X, Y);      else if(n == 1) spmv_sell (&S, X, Y);      else if(!sell) spmm_csr (&A, X, n, Y);      else spmm_sell (&S, X, n, Y);      t = stopwatch_stop (timer);      if(r == 0 || t < best) best = t;    }    double seconds = best;    double rate = (sell ? sell_bytes (&S, n) : csr_bytes (&A, n)) / seconds * 1e-9;    printf("%-10s %3d %10.4f %10.2f %8.2f ", name[v], n, seconds, 2.0 * A.nnz * n / seconds * 1e-9, rate);    if(bandwidth > 0) printf("%7.1f%%  ", 100 * rate / bandwidth); else printf("%8s  ", "?");    verify_relative (Y, Y_ans, A.rows, n, 1e-12);  }  free (X);  free (Y);  free (Y_ans);  sell_free (&S);  csr_free (&A);  stopwatch_destroy (timer);  return 0;}int main(int argc, char** argv){  const char *kernels = DEFAULT_VARIANTS;  char sizes_buf[64];  const char *sizes = "4096";  const char *threads_list = NULL;  const char *bandwidth_file = NULL;  int reps = 1, mode = VERIFY_SAMPLE, crossover = STRASSEN_CROSSOVER, tile = MORTON_TILE;  int opt;  if(argc >= 2 && strcmp (argv[1], "tune") == 0)    return tune_main (argc, argv);  if(argc >= 2 && strcmp (argv[1], "batch") == 0)    return batch_main (argc, argv);  if(argc >= 2 && strcmp (argv[1], "sparse") == 0)    return sparse_main (argc - 1, argv + 1);  if((argc == 4 || argc == 5) && argv[1][0] != '-') {    /* The original interface: one N x K x M problem */    snprintf(sizes_buf, sizeof (sizes_buf), "%sx%sx%s", argv[1], argv[2], argv[3]);    sizes = sizes_buf;    if(argc == 5) crossover = atoi (argv[4]);  } else {    while((opt = getopt (argc, argv, "k:s:t:r:v:c:z:b:h")) != -1) {      switch(opt) {      case 'k': kernels = optarg; break;      case 's': sizes = optarg; break;      case 't': threads_list = optarg; break;      case 'r': reps = atoi (optarg); break;      case 'c': crossover = atoi (optarg); break;      case 'z': tile = atoi (optarg); break;      case 'b': bandwidth_file = optarg; break;      case 'v':        if(strcmp (optarg, "sample") == 0) mode = VERIFY_SAMPLE;        else if(strcmp (optarg, "full") == 0) mode = VERIFY_FULL;        else if(strcmp (optarg, "naive") == 0) mode = VERIFY_NAIVE;        else if(strcmp (optarg, "none") == 0) mode = VERIFY_NONE;        else { usage (argv[0]); return 1; }        break;      default: usage (argv[0]); return 1;      }    }    if(optind != argc || reps < 1 || crossover < 1 || tile < 1) { usage (argv[0]); return 1; }  }  for(int v = 0, found = 0; v <= NUM_VARIANTS; v++) {    if(v == NUM_VARIANTS) {      if(!found) { usage (argv[0]); return 1; }    } else if(in_list (kernels, variants[v].name)) found = 1;  }  if(gemm_load_config (GEMM_CONFIG_FILE)) {    gemm_config_t cfg = gemm_get_config ();    printf("Loaded %s: %dx%d micro-tile, mc %d, kc %d, nc %d\n", GEMM_CONFIG_FILE, cfg.mr, cfg.nr, cfg.mc, cfg.kc, cfg.nc);  }  stopwatch_init ();  struct stopwatch_t* timer = stopwatch_create ();  assert (timer);  /* Thread counts to run at; the default is just the OpenMP maximum */  int max_threads = omp_get_max_threads ();  int thread_counts[64], num_counts = 0;  if(threads_list) {    for(const char *s = threads_list; s && num_counts < 64; s = strchr (s, ',')) {      if(*s == ',') s++;      if(atoi (s) > 0) thread_counts[num_counts++] = atoi (s);    }  }  if(num_counts == 0) thread_counts[num_counts++] = max_threads;  /* The roofline: measured FMA peak, and bandwidth from sb -b */  roofline_t roof[64][2];  double bandwidth = bandwidth_file ? roofline_read_bandwidth (bandwidth_file) : 0;  if(bandwidth_file && bandwidth <= 0) printf("No bandwidth found in %s\n", bandwidth_file);  for(int c = 0; c < num_counts; c++) {    for(int single = 0; single < 2; single++) {      roof[c][single].peak_gflops = roofline_peak (single, thread_counts[c]);      roof[c][single].bandwidth_gbs = bandwidth;    }    printf("%d thread(s): peak %.1f GFLOP/s double, %.1f float", thread_counts[c], roof[c][0].peak_gflops, roof[c][1].peak_gflops);    if(bandwidth > 0) printf("; bandwidth %.1f GB/s, ridge at %.2f flop/byte (double)", bandwidth, roof[c][0].peak_gflops / bandwidth);    printf("\n");  }  for(const char *s = sizes; s; s = strchr (s, ',')) {    int N, K, M;    if(*s == ',') s++;    if(!parse_size (s, &N, &K, &M)) { usage (argv[0]); return 1; }    problem_t p;    p.N = N; p.K = K; p.M = M;    p.crossover = crossover;    p.tile = tile;    p.A = (dtype*) malloc ((size_t) N * K * sizeof (dtype));    p.B = (dtype*) malloc ((size_t) K * M * sizeof (dtype));    p.A_f = (float*) malloc ((size_t) N * K * sizeof (float));    p.B_f = (float*) malloc ((size_t) K * M * sizeof (float));    dtype *C = (dtype*) malloc ((size_t) N * M * sizeof (dtype));    float *C_f = (float*) malloc ((size_t) N * M * sizeof (float));    dtype *C_ref = NULL;    assert (p.A && p.B && p.A_f && p.B_f && C && C_f);    /* initialize A, B */    srand48 (time (NULL));    for(size_t i = 0; i < (size_t) N * K; i++) p.A_f[i] = p.A[i] = drand48 ();    for(size_t i = 0; i < (size_t) K * M; i++) p.B_f[i] = p.B[i] = drand48 ();    printf("\nN: %d K: %d M: %d\n", N, K, M);    int size_mode = mode;  /* falls back to sampling for this size only */    if(mode == VERIFY_FULL || mode == VERIFY_NAIVE) {      /* The reference: the naive loop, or the packed multiply checked by sampling */      C_ref = (dtype*) calloc ((size_t) N * M, sizeof (dtype));      assert (C_ref);      printf("Reference (%s): ", mode == VERIFY_NAIVE ? "naive" : "packed");      fflush (stdout);      if(mode == VERIFY_NAIVE) {        mm_serial (C_ref, p.A, p.B, N, K, M);        printf("done\n");      } else {        mm_blis (C_ref, p.A, p.B, N, K, M);        if(!verify_sampled (&p, PREC_DOUBLE, C_ref, NULL, 1e-10)) {          printf("Reference rejected; sampling instead at this size\n");          size_mode = VERIFY_SAMPLE;        }      }    }    printf("%-9s %7s %10s %10s %8s %8s %10s %7s %6s  %s\n", "kernel", "threads", "seconds", "GFLOP/s", "flop/B", "%peak", "roof", "%roof", "bound", "verification");    for(int v = 0; v < NUM_VARIANTS; v++) {      variant_t *var = &variants[v];      if(!in_list (kernels, var->name)) continue;      if(var->square_only && !(N == K && K == M)) {        printf("%-9s skipped: square sizes only\n", var->name);        continue;      }      double intensity = 2.0 * N * K * M / compulsory_bytes (var->prec, N, K, M);      for(int c = 0; c < num_counts; c++) {        omp_set_num_threads (thread_counts[c]);        if(var->setup) var->setup (&p, thread_counts[c]);        long double t, best = 0;        for(int r = 0; r < reps; r++) {          bzero (C, (size_t) N * M * sizeof (dtype));          bzero (C_f, (size_t) N * M * sizeof (float));          stopwatch_start (timer);          /* do C += A * B */          var->run (&p, C, C_f);          t = stopwatch_stop (timer);          if(r == 0 || t < best) best = t;        }        if(var->cleanup) var->cleanup (&p);        const roofline_t *rl = &roof[c][var->prec == PREC_FLOAT];        double rate = gflops (N, K, M, best);        double bound = roofline_bound (rl, intensity);        printf("%-9s %7d %10.4Lf %10.2f %8.1f %7.1f%% %10.1f %6.1f%% %6s  ", var->name, thread_counts[c], best, rate, intensity,               100 * rate / rl->peak_gflops, bound, 100 * rate / bound,               rl->bandwidth_gbs <= 0 ? "?" : roofline_memory_bound (rl, intensity) ? "memory" : "cpu");        fflush (stdout);        /* verify answer */        dtype tol = var->prec == PREC_FLOAT ? 1e-4 : 1e-9;        if(size_mode == VERIFY_NONE) {          printf("-\n");        } else if(size_mode == VERIFY_SAMPLE) {          verify_sampled (&p, var->prec, C, C_f, tol);        } else {          if(var->prec == PREC_FLOAT)            for(size_t i = 0; i < (size_t) N * M; i++) C[i] = C_f[i];          if(var->prec == PREC_DOUBLE) verify (C, C_ref, N, M);          else verify_relative (C, C_ref, N, M, var->prec == PREC_FLOAT ? 1e-4 : 1e-6);        }      }      omp_set_num_threads (max_threads);    }    free (p.A);    free (p.B);    free (p.A_f);    free (p.B_f);    free (C);    free (C_f);    free (C_ref);  }  stopwatch_destroy (timer);  return 0;}
\ No newline at end of file
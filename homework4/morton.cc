@@ -0,0 +1,180 @@
+/**
+ *  \file morton.cc
+ *  \brief Block-recursive (Morton, or Z-order) matrix storage
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include "batch.hh"
+#include "morton.hh"
+
+#define TASK_LEVELS 2 /*!< Levels of quadrants split into tasks: 4, then 16 */
+
+int morton_levels (int n, int tile)
+{
+  assert (n >= 0 && tile > 0);
+  int levels = 0;
+  while ((long)tile << levels < n)
+    ++levels;
+  return levels;
+}
+
+void morton_init (morton_t* m, int rows, int cols, int tile, int levels)
+{
+  assert (m && rows >= 0 && cols >= 0 && tile > 0 && levels >= 0);
+  assert ((long)tile << levels >= rows && (long)tile << levels >= cols);
+  m->rows = rows;
+  m->cols = cols;
+  m->tile = tile;
+  m->levels = levels;
+  size_t side = (size_t)tile << levels;
+  void* p = NULL;
+  int err = posix_memalign (&p, 64, side * side * sizeof (double));
+  assert (err == 0 && p);
+  m->data = (double *)p;
+  memset (m->data, 0, side * side * sizeof (double));
+}
+
+void morton_free (morton_t* m)
+{
+  free (m->data);
+  m->data = NULL;
+}
+
+size_t morton_offset (const morton_t* m, int ti, int tj)
+{
+  /* Interleave the bits: ti's go to the odd positions, tj's the even */
+  size_t z = 0;
+  for (int b = 0; b < m->levels; ++b)
+    z |= (size_t)((ti >> b) & 1) << (2 * b + 1)
+      | (size_t)((tj >> b) & 1) << (2 * b);
+  return z * m->tile * m->tile;
+}
+
+/** Rows or columns of the matrix in the tile starting at 'first'. */
+static int extent (int size, int first, int tile)
+{
+  int n = size - first;
+  return n < 0 ? 0 : n < tile ? n : tile;
+}
+
+void morton_from_rowmajor (morton_t* m, const double* src, int ld)
+{
+  assert (m && src && ld >= m->cols);
+  const int t = m->tile, grid = 1 << m->levels;
+
+#pragma omp parallel for schedule(static)
+  for (int ti = 0; ti < grid; ++ti)
+    for (int tj = 0; tj < grid; ++tj) {
+      double* dst = m->data + morton_offset (m, ti, tj);
+      int i0 = ti * t, j0 = tj * t;
+      int h = extent (m->rows, i0, t), w = extent (m->cols, j0, t);
+      for (int i = 0; i < h; ++i)
+        memcpy (dst + (size_t)i * t, src + (size_t)(i0 + i) * ld + j0,
+                w * sizeof (double));
+    }
+}
+
+void morton_to_rowmajor (const morton_t* m, double* dst, int ld)
+{
+  assert (m && dst && ld >= m->cols);
+  const int t = m->tile, grid = 1 << m->levels;
+
+#pragma omp parallel for schedule(static)
+  for (int ti = 0; ti < grid; ++ti)
+    for (int tj = 0; tj < grid; ++tj) {
+      const double* src = m->data + morton_offset (m, ti, tj);
+      int i0 = ti * t, j0 = tj * t;
+      int h = extent (m->rows, i0, t), w = extent (m->cols, j0, t);
+      for (int i = 0; i < h; ++i)
+        memcpy (dst + (size_t)(i0 + i) * ld + j0, src + (size_t)i * t,
+                w * sizeof (double));
+    }
+}
+
+/** The multiply's tile size and extent in tiles, N x K x M. */
+struct dims_t {
+  int tile;
+  int n, k, m;
+};
+
+/**
+ *  C += A * B on blocks of 2^level tiles a side, each contiguous; its
+ *  quadrants are the four quarters of it in order. (i, k, j) is where
+ *  the blocks start in the grid, in tiles: blocks wholly in the padding
+ *  are skipped, so rectangular and small matrices do not pay for the
+ *  square power-of-two grid.
+ */
+static void recurse (const dims_t* d, const double* A, const double* B,
+                     double* C, int level, int task_levels, int i, int k,
+                     int j)
+{
+  if (i >= d->n || k >= d->k || j >= d->m)
+    return;
+  if (level == 0) {
+    gemm_small (d->tile, d->tile, d->tile, A, B, C);
+    return;
+  }
+
+  const int h = 1 << (level - 1);
+  const size_t q = ((size_t)d->tile * d->tile) << (2 * (level - 1));
+  const double *A00 = A, *A01 = A + q, *A10 = A + 2 * q, *A11 = A + 3 * q;
+  const double *B00 = B, *B01 = B + q, *B10 = B + 2 * q, *B11 = B + 3 * q;
+  double *C00 = C, *C01 = C + q, *C10 = C + 2 * q, *C11 = C + 3 * q;
+  const int l = level - 1;
+
+  if (task_levels > 0) {
+    /* The quadrants of C are independent; each takes its two products */
+    const double* X[4][2] = { { A00, A01 }, { A00, A01 },
+                              { A10, A11 }, { A10, A11 } };
+    const double* Y[4][2] = { { B00, B10 }, { B01, B11 },
+                              { B00, B10 }, { B01, B11 } };
+    double* Z[4] = { C00, C01, C10, C11 };
+    for (int c = 0; c < 4; ++c) {
+      int ci = i + (c >> 1) * h, cj = j + (c & 1) * h;
+#pragma omp task
+      {
+        recurse (d, X[c][0], Y[c][0], Z[c], l, task_levels - 1, ci, k, cj);
+        recurse (d, X[c][1], Y[c][1], Z[c], l, task_levels - 1, ci, k + h,
+                 cj);
+      }
+    }
+#pragma omp taskwait
+    return;
+  }
+
+  /* In an order where each product shares an operand with the last */
+  recurse (d, A00, B00, C00, l, 0, i, k, j);
+  recurse (d, A00, B01, C01, l, 0, i, k, j + h);
+  recurse (d, A10, B01, C11, l, 0, i + h, k, j + h);
+  recurse (d, A10, B00, C10, l, 0, i + h, k, j);
+  recurse (d, A11, B10, C10, l, 0, i + h, k + h, j);
+  recurse (d, A11, B11, C11, l, 0, i + h, k + h, j + h);
+  recurse (d, A01, B11, C01, l, 0, i, k + h, j + h);
+  recurse (d, A01, B10, C00, l, 0, i, k + h, j);
+}
+
+void mm_morton (morton_t* C, const morton_t* A, const morton_t* B)
+{
+  assert (C && A && B);
+  assert (A->rows == C->rows && A->cols == B->rows && B->cols == C->cols);
+  assert (A->tile == C->tile && B->tile == C->tile);
+  assert (A->levels == C->levels && B->levels == C->levels);
+
+  const int t = C->tile;
+  const dims_t d = { t, (A->rows + t - 1) / t, (A->cols + t - 1) / t,
+                     (B->cols + t - 1) / t };
+  int task_levels = C->levels < TASK_LEVELS ? C->levels : TASK_LEVELS;
+  if (omp_get_max_threads () > 1 && task_levels > 0 && !omp_in_parallel ()) {
+#pragma omp parallel
+#pragma omp single
+    recurse (&d, A->data, B->data, C->data, C->levels, task_levels, 0, 0, 0);
+  } else {
+    recurse (&d, A->data, B->data, C->data, C->levels, 0, 0, 0, 0);
+  }
+}
+
+// eof
@@ -0,0 +1,63 @@
+/**
+ *  \file morton.hh
+ *  \brief Block-recursive (Morton, or Z-order) matrix storage
+ *
+ *  The matrix is cut into tile x tile blocks, each stored row-major and
+ *  contiguous, and the blocks are laid out along the Z curve: first the
+ *  top-left quadrant, then the top-right, bottom-left and bottom-right,
+ *  each of those ordered the same way recursively. Every quadrant at
+ *  every level is therefore one contiguous range, so a recursive
+ *  multiply on quadrants touches compact memory at every scale without
+ *  being told the cache sizes, and no access strides by a row of the
+ *  whole matrix: the TLB and cache-set conflicts a power-of-two leading
+ *  dimension causes in row-major storage cannot occur.
+ *
+ *  The grid of tiles is square, 2^levels on a side, and the padding
+ *  beyond the matrix's rows and columns is kept zero.
+ */
+
+#if !defined (INC_MORTON_HH)
+#define INC_MORTON_HH
+
+#include <stddef.h>
+
+#define MORTON_TILE 32 /*!< Default tile side; has a fixed kernel in batch.hh */
+
+struct morton_t {
+  int rows, cols;   /*!< Size of the matrix held */
+  int tile;         /*!< Side of a tile */
+  int levels;       /*!< The grid is 2^levels tiles on a side */
+  double* data;     /*!< (tile << levels)^2 doubles */
+};
+
+/** Levels needed for a grid of 'tile' tiles to cover n. */
+int morton_levels (int n, int tile);
+
+/**
+ *  Allocates a zeroed rows x cols matrix with the given tile and levels,
+ *  which must cover it. Operands of one multiply need the same tile and
+ *  levels: that of the largest dimension.
+ */
+void morton_init (morton_t* m, int rows, int cols, int tile, int levels);
+
+void morton_free (morton_t* m);
+
+/** Offset of the tile in row ti, column tj of the grid, in doubles. */
+size_t morton_offset (const morton_t* m, int ti, int tj);
+
+/** Copies in a row-major matrix with leading dimension ld. */
+void morton_from_rowmajor (morton_t* m, const double* src, int ld);
+
+/** Copies out to a row-major matrix with leading dimension ld. */
+void morton_to_rowmajor (const morton_t* m, double* dst, int ld);
+
+/**
+ *  C += A * B, recursing on quadrants down to single tiles. The
+ *  quadrants of C are computed as OpenMP tasks on the first levels when
+ *  there are several threads.
+ */
+void mm_morton (morton_t* C, const morton_t* A, const morton_t* B);
+
+#endif
+
+// eof
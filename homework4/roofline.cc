@@ -0,0 +1,163 @@
+/**
+ *  \file roofline.cc
+ *  \brief Machine limits for placing kernels on a roofline
+ */
+
+#include <stdio.h>
+#include <omp.h>
+
+#if defined (__AVX2__) && defined (__FMA__)
+#include <immintrin.h>
+#endif
+
+#include "roofline.hh"
+
+#define PEAK_CHAINS 12       /*!< Independent FMAs in flight, to hide latency */
+#define PEAK_ITERATIONS 20000000L
+#define PEAK_TRIALS 5        /*!< Best of, against frequency ramp-up and noise */
+
+#if defined (__AVX2__) && defined (__FMA__)
+
+/** Vector FMA chains on one thread; returns a value to keep them live. */
+template <typename V>
+static double chains (long iterations);
+
+template <>
+double chains<__m256d> (long iterations)
+{
+  __m256d x[PEAK_CHAINS];
+  const __m256d m = _mm256_set1_pd (1.0000001), a = _mm256_set1_pd (1e-9);
+#pragma GCC unroll 16
+  for (int c = 0; c < PEAK_CHAINS; ++c)
+    x[c] = _mm256_set1_pd (c);
+  for (long i = 0; i < iterations; ++i)
+#pragma GCC unroll 16
+    for (int c = 0; c < PEAK_CHAINS; ++c)
+      x[c] = _mm256_fmadd_pd (x[c], m, a);
+  double out[4], sum = 0;
+  for (int c = 0; c < PEAK_CHAINS; ++c) {
+    _mm256_storeu_pd (out, x[c]);
+    sum += out[0];
+  }
+  return sum;
+}
+
+template <>
+double chains<__m256> (long iterations)
+{
+  __m256 x[PEAK_CHAINS];
+  const __m256 m = _mm256_set1_ps (1.0000001f), a = _mm256_set1_ps (1e-9f);
+#pragma GCC unroll 16
+  for (int c = 0; c < PEAK_CHAINS; ++c)
+    x[c] = _mm256_set1_ps (c);
+  for (long i = 0; i < iterations; ++i)
+#pragma GCC unroll 16
+    for (int c = 0; c < PEAK_CHAINS; ++c)
+      x[c] = _mm256_fmadd_ps (x[c], m, a);
+  float out[8];
+  double sum = 0;
+  for (int c = 0; c < PEAK_CHAINS; ++c) {
+    _mm256_storeu_ps (out, x[c]);
+    sum += out[0];
+  }
+  return sum;
+}
+
+static double run_chains (bool single)
+{
+  return single ? chains<__m256> (PEAK_ITERATIONS)
+    : chains<__m256d> (PEAK_ITERATIONS);
+}
+
+static int lanes (bool single)
+{
+  return single ? 8 : 4;
+}
+
+#else
+
+#define PEAK_BYTES 16  /*!< SSE2 width, which every x86-64 compiler targets */
+
+/**
+ *  Chains PEAK_BYTES wide, which the compiler vectorizes as it does the
+ *  portable GEMM kernel.
+ */
+template <typename T>
+static double chains (long iterations)
+{
+  const int L = PEAK_BYTES / sizeof (T);
+  T x[PEAK_CHAINS][L];
+  for (int c = 0; c < PEAK_CHAINS; ++c)
+    for (int l = 0; l < L; ++l)
+      x[c][l] = c;
+  for (long i = 0; i < iterations; ++i)
+    for (int c = 0; c < PEAK_CHAINS; ++c)
+      for (int l = 0; l < L; ++l)
+        x[c][l] = x[c][l] * (T)1.0000001 + (T)1e-9;
+  double sum = 0;
+  for (int c = 0; c < PEAK_CHAINS; ++c)
+    sum += x[c][0];
+  return sum;
+}
+
+static double run_chains (bool single)
+{
+  return single ? chains<float> (PEAK_ITERATIONS)
+    : chains<double> (PEAK_ITERATIONS);
+}
+
+static int lanes (bool single)
+{
+  return PEAK_BYTES / (single ? sizeof (float) : sizeof (double));
+}
+
+#endif
+
+double roofline_peak (bool single, int threads)
+{
+  double sink = 0, best = 0;
+  for (int trial = 0; trial < PEAK_TRIALS; ++trial) {
+    double t = omp_get_wtime ();
+#pragma omp parallel num_threads(threads) reduction(+:sink)
+    sink += run_chains (single);
+    t = omp_get_wtime () - t;
+    if (trial == 0 || t < best)
+      best = t;
+  }
+  if (sink == 0.5)  /* never true; keeps the chains from being removed */
+    printf ("%g\n", sink);
+  return 2.0 * lanes (single) * PEAK_CHAINS * PEAK_ITERATIONS * threads
+    / best * 1e-9;
+}
+
+double roofline_read_bandwidth (const char* filename)
+{
+  FILE* fp = fopen (filename, "r");
+  if (!fp)
+    return 0;
+  char line[256], name[64];
+  double rate, best = 0;
+  while (fgets (line, sizeof (line), fp)) {
+    if (line[0] != '#' && sscanf (line, "%63s %lf", name, &rate) == 2
+        && rate > best)
+      best = rate;
+  }
+  fclose (fp);
+  return best;
+}
+
+double roofline_bound (const roofline_t* r, double intensity)
+{
+  if (r->bandwidth_gbs <= 0)
+    return r->peak_gflops;
+  double memory = intensity * r->bandwidth_gbs;
+  return memory < r->peak_gflops ? memory : r->peak_gflops;
+}
+
+bool roofline_memory_bound (const roofline_t* r, double intensity)
+{
+  return r->bandwidth_gbs > 0
+    && intensity * r->bandwidth_gbs < r->peak_gflops;
+}
+
+// eof
@@ -0,0 +1,39 @@
+/**
+ *  \file roofline.hh
+ *  \brief Machine limits for placing kernels on a roofline
+ *
+ *  A kernel doing F flops on B bytes of compulsory memory traffic has
+ *  arithmetic intensity I = F / B and cannot run faster than
+ *  min(peak, I * bandwidth). The peak is measured here with a loop of
+ *  independent FMAs; the bandwidth comes from 'sb -b' output.
+ */
+
+#if !defined (INC_ROOFLINE_HH)
+#define INC_ROOFLINE_HH
+
+struct roofline_t {
+  double peak_gflops;     /*!< Floating-point peak for the precision */
+  double bandwidth_gbs;   /*!< Streaming bandwidth; 0 if unknown */
+};
+
+/**
+ *  Measures the FMA peak on 'threads' threads, in GFLOP/s, for float
+ *  arithmetic if 'single' is set, else double.
+ */
+double roofline_peak (bool single, int threads);
+
+/**
+ *  Reads the output of 'sb -b' and returns the best of its rates in
+ *  GB/s, or 0 if the file cannot be read.
+ */
+double roofline_read_bandwidth (const char* filename);
+
+/** Highest rate the roofline allows at 'intensity' flops per byte. */
+double roofline_bound (const roofline_t* r, double intensity);
+
+/** Whether 'intensity' lies left of the ridge point, i.e. memory bound. */
+bool roofline_memory_bound (const roofline_t* r, double intensity);
+
+#endif
+
+// eof
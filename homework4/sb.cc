@@ -1,10 +1,19 @@
 /**
  *  \file sb.cc
  *  \brief Saavedra-Barrera benchmark
+ *
+ *  usage: ./sb <n>          read latency by array size and stride
+ *         ./sb -b <MiB>     streaming bandwidth on arrays of that size
+ *
+ *  The bandwidth mode prints "read", "copy" and "triad" rates in GB/s,
+ *  counting every byte loaded or stored; mm.cc reads that output to
+ *  place its kernels on a roofline. With OpenMP the streams are split
+ *  across threads.
  */
 
 #include <cassert>
 #include <cstdlib>
+#include <cstring>
 #include <algorithm>
 #include <iostream>
 
@@ -48,17 +57,97 @@ bench (int n, int* Index)
   return cur;
 }
 
+  double
+stream (int kernel, long n, double* a, const double* b, const double* c)
+{
+  double sum = 0;
+  switch (kernel) {
+  case 0: /* read */
+#pragma omp parallel for simd reduction(+:sum)
+    for (long i = 0; i < n; ++i)
+      sum += b[i];
+    break;
+  case 1: /* copy */
+#pragma omp parallel for
+    for (long i = 0; i < n; ++i)
+      a[i] = b[i];
+    break;
+  default: /* triad */
+#pragma omp parallel for
+    for (long i = 0; i < n; ++i)
+      a[i] = b[i] + 3.0 * c[i];
+    break;
+  }
+  return sum;
+}
+
+  int
+bandwidth (long mib, struct stopwatch_t* timer)
+{
+  static const char* names[] = { "read", "copy", "triad" };
+  static const int arrays[] = { 1, 2, 3 }; /* arrays each kernel touches */
+  long n = mib * (1L << 20) / sizeof (double);
+  assert (n > 0);
+  double* a = new double[n];
+  double* b = new double[n];
+  double* c = new double[n];
+  assert (a && b && c);
+  for (long i = 0; i < n; ++i) {
+    a[i] = 0;
+    b[i] = 1;
+    c[i] = 2;
+  }
+
+  cout << "# bandwidth in GB/s, " << mib << " MiB per array" << endl;
+  struct stopwatch_t* one = stopwatch_create ();
+  assert (one);
+  double dummy = 0;
+  for (int kernel = 0; kernel < 3; ++kernel) {
+    // As for latency: enough repetitions for 0.1 sec, best of them counts
+    long double t = 0, best = 0;
+    long int num_trials = 0;
+    stopwatch_start (timer);
+    do {
+      stopwatch_start (one);
+      dummy += stream (kernel, n, a, b, c);
+      long double dt = stopwatch_stop (one);
+      if (num_trials == 0 || dt < best)
+        best = dt;
+      ++num_trials;
+      t = stopwatch_elapsed (timer);
+    } while (t < 0.1 || num_trials < 3);
+    stopwatch_stop (timer);
+    cerr << "  " << names[kernel] << ": " << num_trials << " trials [dummy="
+         << dummy << "]" << endl;
+    cout << names[kernel] << ' '
+         << arrays[kernel] * n * sizeof (double) / best * 1e-9 << endl;
+  }
+
+  stopwatch_destroy (one);
+  delete[] a;
+  delete[] b;
+  delete[] c;
+  return 0;
+}
+
   int
 main (int argc, char* argv[])
 {
-  if (argc != 2) {
-    cerr << "usage: " << argv[0] << " <n>" << endl;
+  bool bw = argc == 3 && strcmp (argv[1], "-b") == 0;
+  if (argc != 2 && !bw) {
+    cerr << "usage: " << argv[0] << " <n>" << endl
+         << "       " << argv[0] << " -b <MiB per array>" << endl;
     return -1;
   }
 
   stopwatch_init ();
   struct stopwatch_t* timer = stopwatch_create ();
   assert (timer);
+  if (bw) {
+    int err = bandwidth (atol (argv[2]), timer);
+    stopwatch_destroy (timer);
+    return err;
+  }
 
   int n_max = atoi (argv[1]); assert (n_max >= 2);
   int* Index = new int[n_max]; assert (Index);
@@ -0,0 +1,81 @@
+/**
+ *  \file simd.hh
+ *  \brief Vector operations the multiply kernels are written in
+ *
+ *  The kernels in gemm.cc and batch.cc are templates over the element
+ *  types; simd<T, Acc> gives them, for each pair, the handful of AVX2
+ *  operations they need. Without AVX2 and FMA only lanes<> is defined
+ *  and the kernels fall back to plain C.
+ */
+
+#if !defined (INC_SIMD_HH)
+#define INC_SIMD_HH
+
+#if defined (__AVX2__) && defined (__FMA__)
+#include <immintrin.h>
+#endif
+
+/** Accumulator lanes per 256-bit vector: a tile row is NV of these wide. */
+template <typename Acc>
+struct lanes {
+  enum { value = 32 / sizeof (Acc) };
+};
+
+#if defined (__AVX2__) && defined (__FMA__)
+
+/**
+ *  The vector operations each element type's micro-kernel is built from:
+ *  a broadcast of one A value, a load of one vector of B (aligned, from
+ *  a packed panel, or not), the fused multiply-add, and the update of C.
+ */
+template <typename T, typename Acc>
+struct simd;
+
+/** Double: 4 lanes. */
+template <>
+struct simd<double, double> {
+  typedef __m256d vec;
+  static vec zero (void) { return _mm256_setzero_pd (); }
+  static vec bcast (const double* a) { return _mm256_broadcast_sd (a); }
+  static vec load (const double* b) { return _mm256_load_pd (b); }
+  static vec loadu (const double* b) { return _mm256_loadu_pd (b); }
+  static vec fmadd (vec a, vec b, vec c) { return _mm256_fmadd_pd (a, b, c); }
+  static void update (double* c, vec v)
+  { _mm256_storeu_pd (c, _mm256_add_pd (_mm256_loadu_pd (c), v)); }
+};
+
+/** Float: 8 lanes, so twice the flops per instruction. */
+template <>
+struct simd<float, float> {
+  typedef __m256 vec;
+  static vec zero (void) { return _mm256_setzero_ps (); }
+  static vec bcast (const float* a) { return _mm256_broadcast_ss (a); }
+  static vec load (const float* b) { return _mm256_load_ps (b); }
+  static vec loadu (const float* b) { return _mm256_loadu_ps (b); }
+  static vec fmadd (vec a, vec b, vec c) { return _mm256_fmadd_ps (a, b, c); }
+  static void update (float* c, vec v)
+  { _mm256_storeu_ps (c, _mm256_add_ps (_mm256_loadu_ps (c), v)); }
+};
+
+/**
+ *  Float storage, double accumulation: A is widened when packed, and B
+ *  4 floats at a time as it is loaded, so the packed panel of B takes
+ *  half the cache of a double one while the sums keep double precision.
+ */
+template <>
+struct simd<float, double> {
+  typedef __m256d vec;
+  static vec zero (void) { return _mm256_setzero_pd (); }
+  static vec bcast (const double* a) { return _mm256_broadcast_sd (a); }
+  static vec load (const float* b) { return _mm256_cvtps_pd (_mm_load_ps (b)); }
+  static vec loadu (const float* b) { return _mm256_cvtps_pd (_mm_loadu_ps (b)); }
+  static vec fmadd (vec a, vec b, vec c) { return _mm256_fmadd_pd (a, b, c); }
+  static void update (double* c, vec v)
+  { _mm256_storeu_pd (c, _mm256_add_pd (_mm256_loadu_pd (c), v)); }
+};
+
+#endif
+
+#endif
+
+// eof
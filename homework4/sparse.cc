@@ -0,0 +1,374 @@
+/**
+ *  \file sparse.cc
+ *  \brief Sparse matrices in CSR and SELL-C-sigma, and their products
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <omp.h>
+
+#if defined (__AVX2__) && defined (__FMA__)
+#include <immintrin.h>
+#endif
+
+#include "sparse.hh"
+
+/** One nonzero, while the matrix is built. */
+struct entry_t {
+  int row, col;
+  double val;
+};
+
+static int compare_entries (const void* a, const void* b)
+{
+  const entry_t *x = (const entry_t *)a, *y = (const entry_t *)b;
+  if (x->row != y->row)
+    return x->row < y->row ? -1 : 1;
+  return x->col < y->col ? -1 : x->col > y->col;
+}
+
+/** Builds A from nnz entries, which it sorts. */
+static void csr_from_entries (csr_t* A, int rows, int cols, entry_t* e,
+                              long nnz)
+{
+  qsort (e, nnz, sizeof (entry_t), compare_entries);
+  A->rows = rows;
+  A->cols = cols;
+  A->nnz = nnz;
+  A->row_ptr = (long *)calloc (rows + 1, sizeof (long));
+  A->col = (int *)malloc ((nnz > 0 ? nnz : 1) * sizeof (int));
+  A->val = (double *)malloc ((nnz > 0 ? nnz : 1) * sizeof (double));
+  assert (A->row_ptr && A->col && A->val);
+  for (long p = 0; p < nnz; ++p) {
+    A->row_ptr[e[p].row + 1]++;
+    A->col[p] = e[p].col;
+    A->val[p] = e[p].val;
+  }
+  for (int i = 0; i < rows; ++i)
+    A->row_ptr[i + 1] += A->row_ptr[i];
+}
+
+bool csr_read_mm (const char* filename, csr_t* A)
+{
+  FILE* fp = fopen (filename, "r");
+  if (!fp) {
+    fprintf (stderr, "%s: cannot open\n", filename);
+    return false;
+  }
+
+  char line[1024], object[64], format[64], field[64], symmetry[64];
+  if (!fgets (line, sizeof (line), fp)
+      || sscanf (line, "%%%%MatrixMarket %63s %63s %63s %63s", object, format,
+                 field, symmetry) != 4
+      || strcasecmp (object, "matrix") != 0
+      || strcasecmp (format, "coordinate") != 0) {
+    fprintf (stderr, "%s: not a Matrix Market coordinate matrix\n", filename);
+    fclose (fp);
+    return false;
+  }
+  bool pattern = strcasecmp (field, "pattern") == 0;
+  bool symmetric = strcasecmp (symmetry, "symmetric") == 0;
+  bool skew = strcasecmp (symmetry, "skew-symmetric") == 0;
+  if ((!pattern && strcasecmp (field, "real") != 0
+       && strcasecmp (field, "integer") != 0)
+      || (!symmetric && !skew && strcasecmp (symmetry, "general") != 0)) {
+    fprintf (stderr, "%s: %s %s matrices are not supported\n", filename,
+             field, symmetry);
+    fclose (fp);
+    return false;
+  }
+
+  /* Comments, then the size line */
+  int rows = 0, cols = 0;
+  long entries = -1;
+  while (fgets (line, sizeof (line), fp))
+    if (line[0] != '%') {
+      if (sscanf (line, "%d %d %ld", &rows, &cols, &entries) != 3)
+        entries = -1;
+      break;
+    }
+  if (entries < 0 || rows < 0 || cols < 0) {
+    fprintf (stderr, "%s: bad size line\n", filename);
+    fclose (fp);
+    return false;
+  }
+
+  entry_t* e = (entry_t *)malloc ((2 * entries + 1) * sizeof (entry_t));
+  assert (e);
+  long nnz = 0;
+  for (long p = 0; p < entries; ++p) {
+    int i, j;
+    double v = 1;
+    if (!fgets (line, sizeof (line), fp)
+        || sscanf (line, "%d %d %lf", &i, &j, &v) < (pattern ? 2 : 3)
+        || i < 1 || i > rows || j < 1 || j > cols) {
+      fprintf (stderr, "%s: bad entry %ld\n", filename, p + 1);
+      free (e);
+      fclose (fp);
+      return false;
+    }
+    e[nnz].row = i - 1;
+    e[nnz].col = j - 1;
+    e[nnz++].val = v;
+    if ((symmetric || skew) && i != j) {
+      e[nnz].row = j - 1;
+      e[nnz].col = i - 1;
+      e[nnz++].val = skew ? -v : v;
+    }
+  }
+  fclose (fp);
+
+  csr_from_entries (A, rows, cols, e, nnz);
+  free (e);
+  return true;
+}
+
+void csr_random (csr_t* A, int rows, int cols, int per_row, unsigned seed)
+{
+  assert (A && rows > 0 && cols > 0 && per_row > 0);
+  unsigned short state[3] = { (unsigned short)seed,
+                              (unsigned short)(seed >> 16), 0x330e };
+  long nnz = 0;
+  int* len = (int *)malloc (rows * sizeof (int));
+  assert (len);
+  for (int i = 0; i < rows; ++i) {
+    len[i] = 1 + nrand48 (state) % (2 * per_row - 1);
+    if (len[i] > cols)
+      len[i] = cols;
+    nnz += len[i];
+  }
+
+  entry_t* e = (entry_t *)malloc (nnz * sizeof (entry_t));
+  assert (e);
+  long p = 0;
+  for (int i = 0; i < rows; ++i)
+    for (int l = 0; l < len[i]; ++l) {
+      e[p].row = i;
+      e[p].col = nrand48 (state) % cols;
+      e[p++].val = erand48 (state);
+    }
+  free (len);
+
+  csr_from_entries (A, rows, cols, e, nnz);
+  free (e);
+}
+
+void csr_free (csr_t* A)
+{
+  free (A->row_ptr);
+  free (A->col);
+  free (A->val);
+  A->row_ptr = NULL;
+  A->col = NULL;
+  A->val = NULL;
+}
+
+/** For sorting rows by decreasing length, as (length, row) pairs. */
+static int compare_lengths (const void* a, const void* b)
+{
+  const long *x = (const long *)a, *y = (const long *)b;
+  if (x[0] != y[0])
+    return x[0] > y[0] ? -1 : 1;
+  return x[1] < y[1] ? -1 : x[1] > y[1];
+}
+
+void sell_from_csr (sell_t* S, const csr_t* A, int C, int sigma)
+{
+  assert (S && A && C > 0 && C <= SELL_C_MAX);
+  assert (sigma == 1 || (sigma > 0 && sigma % C == 0));
+  S->rows = A->rows;
+  S->cols = A->cols;
+  S->nnz = A->nnz;
+  S->C = C;
+  S->sigma = sigma;
+  S->slices = (A->rows + C - 1) / C;
+  S->perm = (int *)malloc ((A->rows > 0 ? A->rows : 1) * sizeof (int));
+  S->slice_ptr = (long *)malloc ((S->slices + 1) * sizeof (long));
+  assert (S->perm && S->slice_ptr);
+
+  /* Sort each window of sigma rows by length, longest first */
+  long* order = (long *)malloc (2 * sigma * sizeof (long));
+  assert (order);
+  for (int w = 0; w < A->rows; w += sigma) {
+    int n = A->rows - w < sigma ? A->rows - w : sigma;
+    for (int r = 0; r < n; ++r) {
+      order[2 * r] = A->row_ptr[w + r + 1] - A->row_ptr[w + r];
+      order[2 * r + 1] = w + r;
+    }
+    if (sigma > 1)
+      qsort (order, n, 2 * sizeof (long), compare_lengths);
+    for (int r = 0; r < n; ++r)
+      S->perm[w + r] = (int)order[2 * r + 1];
+  }
+  free (order);
+
+  /* Each slice is as wide as its longest row */
+  S->slice_ptr[0] = 0;
+  for (int s = 0; s < S->slices; ++s) {
+    long width = 0;
+    for (int r = s * C; r < (s + 1) * C && r < A->rows; ++r) {
+      int i = S->perm[r];
+      long len = A->row_ptr[i + 1] - A->row_ptr[i];
+      if (len > width)
+        width = len;
+    }
+    S->slice_ptr[s + 1] = S->slice_ptr[s] + width * C;
+  }
+
+  long stored = S->slice_ptr[S->slices];
+  S->col = (int *)calloc (stored > 0 ? stored : 1, sizeof (int));
+  S->val = (double *)calloc (stored > 0 ? stored : 1, sizeof (double));
+  assert (S->col && S->val);
+
+#pragma omp parallel for schedule(static)
+  for (int s = 0; s < S->slices; ++s)
+    for (int r = 0; r < C && s * C + r < A->rows; ++r) {
+      int i = S->perm[s * C + r];
+      for (long p = A->row_ptr[i]; p < A->row_ptr[i + 1]; ++p) {
+        long q = S->slice_ptr[s] + (p - A->row_ptr[i]) * C + r;
+        S->col[q] = A->col[p];
+        S->val[q] = A->val[p];
+      }
+    }
+}
+
+void sell_free (sell_t* S)
+{
+  free (S->slice_ptr);
+  free (S->perm);
+  free (S->col);
+  free (S->val);
+  S->slice_ptr = NULL;
+  S->perm = NULL;
+  S->col = NULL;
+  S->val = NULL;
+}
+
+void spmv_csr (const csr_t* A, const double* x, double* y)
+{
+  assert (A && x && y);
+#pragma omp parallel for schedule(dynamic, 256)
+  for (int i = 0; i < A->rows; ++i) {
+    double sum = 0;
+#pragma omp simd reduction(+:sum)
+    for (long p = A->row_ptr[i]; p < A->row_ptr[i + 1]; ++p)
+      sum += A->val[p] * x[A->col[p]];
+    y[i] += sum;
+  }
+}
+
+#if defined (__AVX2__) && defined (__FMA__)
+
+/* GCC 12 takes the gather's deliberately undefined source for a bug */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+/**
+ *  One slice of SELL_C rows: each column of the slice is two vectors of
+ *  values, multiplied with x gathered at their column indices.
+ */
+static void sell_slice (const sell_t* S, int s, const double* x, double* y)
+{
+  const long begin = S->slice_ptr[s], end = S->slice_ptr[s + 1];
+  __m256d lo = _mm256_setzero_pd (), hi = _mm256_setzero_pd ();
+  for (long q = begin; q < end; q += SELL_C) {
+    __m128i c0 = _mm_loadu_si128 ((const __m128i *)(S->col + q));
+    __m128i c1 = _mm_loadu_si128 ((const __m128i *)(S->col + q + 4));
+    lo = _mm256_fmadd_pd (_mm256_loadu_pd (S->val + q),
+                          _mm256_i32gather_pd (x, c0, 8), lo);
+    hi = _mm256_fmadd_pd (_mm256_loadu_pd (S->val + q + 4),
+                          _mm256_i32gather_pd (x, c1, 8), hi);
+  }
+  double sum[SELL_C];
+  _mm256_storeu_pd (sum, lo);
+  _mm256_storeu_pd (sum + 4, hi);
+  for (int r = 0; r < SELL_C && s * SELL_C + r < S->rows; ++r)
+    y[S->perm[s * SELL_C + r]] += sum[r];
+}
+
+#pragma GCC diagnostic pop
+
+#endif
+
+void spmv_sell (const sell_t* S, const double* x, double* y)
+{
+  assert (S && x && y);
+  const int C = S->C;
+#pragma omp parallel for schedule(dynamic, 32)
+  for (int s = 0; s < S->slices; ++s) {
+#if defined (__AVX2__) && defined (__FMA__)
+    if (C == SELL_C) {
+      sell_slice (S, s, x, y);
+      continue;
+    }
+#endif
+    double sum[SELL_C_MAX];
+    for (int r = 0; r < C; ++r)
+      sum[r] = 0;
+    for (long q = S->slice_ptr[s]; q < S->slice_ptr[s + 1]; q += C)
+#pragma omp simd
+      for (int r = 0; r < C; ++r)
+        sum[r] += S->val[q + r] * x[S->col[q + r]];
+    for (int r = 0; r < C && s * C + r < S->rows; ++r)
+      y[S->perm[s * C + r]] += sum[r];
+  }
+}
+
+void spmm_csr (const csr_t* A, const double* X, int k, double* Y)
+{
+  assert (A && X && Y && k > 0);
+#pragma omp parallel for schedule(dynamic, 64)
+  for (int i = 0; i < A->rows; ++i) {
+    double* __restrict__ y = Y + (size_t)i * k;
+    for (long p = A->row_ptr[i]; p < A->row_ptr[i + 1]; ++p) {
+      const double a = A->val[p];
+      const double* __restrict__ x = X + (size_t)A->col[p] * k;
+#pragma omp simd
+      for (int t = 0; t < k; ++t)
+        y[t] += a * x[t];
+    }
+  }
+}
+
+void spmm_sell (const sell_t* S, const double* X, int k, double* Y)
+{
+  assert (S && X && Y && k > 0);
+  const int C = S->C;
+#pragma omp parallel for schedule(dynamic, 16)
+  for (int s = 0; s < S->slices; ++s) {
+    int n = S->rows - s * C < C ? S->rows - s * C : C;
+    for (long q = S->slice_ptr[s]; q < S->slice_ptr[s + 1]; q += C)
+      for (int r = 0; r < n; ++r) {
+        const double a = S->val[q + r];
+        if (a == 0)  /* padding, mostly */
+          continue;
+        double* __restrict__ y = Y + (size_t)S->perm[s * C + r] * k;
+        const double* __restrict__ x = X + (size_t)S->col[q + r] * k;
+#pragma omp simd
+        for (int t = 0; t < k; ++t)
+          y[t] += a * x[t];
+      }
+  }
+}
+
+double csr_bytes (const csr_t* A, int k)
+{
+  /* The matrix once; X and Y once each, Y read and written */
+  return (double)A->nnz * (sizeof (double) + sizeof (int))
+    + (double)(A->rows + 1) * sizeof (long)
+    + (double)k * sizeof (double) * (A->cols + 2.0 * A->rows);
+}
+
+double sell_bytes (const sell_t* S, int k)
+{
+  /* As CSR, with the padding and the row permutation */
+  return (double)S->slice_ptr[S->slices] * (sizeof (double) + sizeof (int))
+    + (double)(S->slices + 1) * sizeof (long)
+    + (double)S->rows * sizeof (int)
+    + (double)k * sizeof (double) * (S->cols + 2.0 * S->rows);
+}
+
+// eof
@@ -0,0 +1,80 @@
+/**
+ *  \file sparse.hh
+ *  \brief Sparse matrices in CSR and SELL-C-sigma, and their products
+ *
+ *  CSR keeps each row's nonzeros, column indices and values, one row
+ *  after another. The row-wise loops it gives vectorize only within a
+ *  row, poorly when rows are short. SELL-C-sigma cuts the rows into
+ *  slices of C and stores each slice column-major, padded to its longest
+ *  row: one vector then holds an entry of each of C rows, whatever their
+ *  length. Sorting the rows by length within windows of sigma rows
+ *  before slicing keeps the padding small.
+ *
+ *  The products are y += A x (SpMV) and Y += A X (SpMM) for k right-hand
+ *  sides, X and Y row-major, A's rows split between OpenMP threads. Both
+ *  are bound by memory bandwidth: the *_bytes() functions give the
+ *  traffic each must move at least, to compare the effective bandwidth
+ *  with what 'sb -b' measures.
+ */
+
+#if !defined (INC_SPARSE_HH)
+#define INC_SPARSE_HH
+
+#define SELL_C 8       /*!< Rows per slice: two 4-double vectors */
+#define SELL_SIGMA 256 /*!< Rows sorted by length together */
+#define SELL_C_MAX 64  /*!< Largest slice sell_from_csr() takes */
+
+struct csr_t {
+  int rows, cols;
+  long nnz;
+  long* row_ptr;   /*!< rows + 1 offsets into col and val */
+  int* col;
+  double* val;
+};
+
+struct sell_t {
+  int rows, cols;
+  long nnz;          /*!< Nonzeros, not counting the padding */
+  int C, sigma;
+  int slices;
+  long* slice_ptr;   /*!< slices + 1 offsets into col and val */
+  int* perm;         /*!< Row of the matrix stored as row i */
+  int* col;          /*!< Padding has column 0 and value 0 */
+  double* val;
+};
+
+/**
+ *  Reads a Matrix Market coordinate file (real, integer or pattern;
+ *  general, symmetric or skew-symmetric), expanding symmetric matrices
+ *  to both triangles. Returns false, with a message, if it cannot.
+ */
+bool csr_read_mm (const char* filename, csr_t* A);
+
+/**
+ *  A rows x cols matrix with random values and columns, row lengths
+ *  uniform in 1 .. 2 * per_row - 1.
+ */
+void csr_random (csr_t* A, int rows, int cols, int per_row, unsigned seed);
+
+void csr_free (csr_t* A);
+
+/** Converts to SELL-C-sigma; sigma a multiple of C, or 1 for no sorting. */
+void sell_from_csr (sell_t* S, const csr_t* A, int C, int sigma);
+
+void sell_free (sell_t* S);
+
+/** y += A x */
+void spmv_csr (const csr_t* A, const double* x, double* y);
+void spmv_sell (const sell_t* S, const double* x, double* y);
+
+/** Y += A X, X cols x k and Y rows x k */
+void spmm_csr (const csr_t* A, const double* X, int k, double* Y);
+void spmm_sell (const sell_t* S, const double* X, int k, double* Y);
+
+/** Bytes a product with k right-hand sides reads and writes at least. */
+double csr_bytes (const csr_t* A, int k);
+double sell_bytes (const sell_t* S, int k);
+
+#endif
+
+// eof
@@ -0,0 +1,216 @@
+/**
+ *  \file strassen.cc
+ *  \brief Strassen-Winograd multiply on top of the packed GEMM
+ *
+ *  With the quadrants of A, B and C numbered 11, 12, 21, 22:
+ *
+ *    S1 = A21 + A22   S2 = S1 - A11   S3 = A11 - A21   S4 = A12 - S2
+ *    T1 = B12 - B11   T2 = B22 - T1   T3 = B22 - B12   T4 = T2 - B21
+ *
+ *    P1 = A11 B11   P2 = A12 B21   P3 = S4 B22   P4 = A22 T4
+ *    P5 = S1 T1     P6 = S2 T2     P7 = S3 T3
+ *
+ *    C11 += P1 + P2              C12 += P1 + P6 + P5 + P3
+ *    C21 += P1 + P6 + P7 - P4    C22 += P1 + P6 + P7 + P5
+ *
+ *  Since the recursion accumulates into its output, P2, P3 and P4 (each
+ *  needed in one quadrant only) go straight into C when the products run
+ *  in sequence; the others go through one shared buffer and are added
+ *  where needed. T4 is kept negated so that P4 can be accumulated too.
+ *  When the products run as tasks, each has a buffer of its own and the
+ *  quadrants are formed afterwards.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include "gemm.hh"
+#include "strassen.hh"
+
+/** Whether an n x n multiply goes straight to gemm(). */
+static bool is_leaf (int n, int crossover)
+{
+  return n <= crossover || n % 2 != 0;
+}
+
+/**
+ *  Doubles of packing space for gemm() at a leaf: for one thread below
+ *  the root when tasks are used, since the leaves then run inside the
+ *  parallel region, and for 'threads' otherwise.
+ */
+static size_t leaf_workspace (int task_levels, int threads, int level)
+{
+  if (task_levels > 0 && level > 0)
+    threads = 1;
+  return (gemm_workspace (threads) + sizeof (double) - 1) / sizeof (double);
+}
+
+static size_t workspace (int n, int crossover, int task_levels, int threads,
+                         int level)
+{
+  if (is_leaf (n, crossover))
+    return leaf_workspace (task_levels, threads, level);
+  size_t hh = (size_t)(n / 2) * (n / 2);
+  size_t child = workspace (n / 2, crossover, task_levels, threads, level + 1);
+  if (level < task_levels)
+    return 8 * hh + 7 * (hh + child);  /* S, T; then a P and workspace each */
+  return 8 * hh + hh + child;          /* S, T; one P and workspace shared */
+}
+
+size_t strassen_workspace (int n, int crossover, int task_levels)
+{
+  return workspace (n, crossover, task_levels, omp_get_max_threads (), 0);
+}
+
+void strassen_init (strassen_t* s, int n, int crossover, int task_levels)
+{
+  assert (s && n > 0 && crossover > 0 && task_levels >= 0);
+  s->n = n;
+  s->crossover = crossover;
+  s->task_levels = task_levels;
+  s->threads = omp_get_max_threads ();
+  s->arena_size = workspace (n, crossover, task_levels, s->threads, 0);
+  s->arena = (double *)malloc (s->arena_size * sizeof (double));
+  assert (s->arena);
+}
+
+void strassen_free (strassen_t* s)
+{
+  free (s->arena);
+  s->arena = NULL;
+  s->arena_size = 0;
+}
+
+/** Z = X + sign * Y, all h x h; Z is dense. */
+static void combine (int h, const double* X, int ldx, const double* Y, int ldy,
+                     double sign, double* Z)
+{
+  for (int i = 0; i < h; ++i)
+    for (int j = 0; j < h; ++j)
+      Z[(size_t)i * h + j] = X[(size_t)i * ldx + j]
+        + sign * Y[(size_t)i * ldy + j];
+}
+
+/** C += P, C h x h with leading dimension ldc, P dense. */
+static void accumulate (int h, const double* P, double* C, int ldc)
+{
+  for (int i = 0; i < h; ++i)
+    for (int j = 0; j < h; ++j)
+      C[(size_t)i * ldc + j] += P[(size_t)i * h + j];
+}
+
+/**
+ *  C += A * B, n x n; 'work' is the part of the arena workspace() laid
+ *  out for this n and level.
+ */
+static void recurse (const strassen_t* s, int n, const double* A, int lda,
+                     const double* B, int ldb, double* C, int ldc,
+                     double* work, int level)
+{
+  if (is_leaf (n, s->crossover)) {
+    gemm_ws (n, n, n, A, lda, B, ldb, C, ldc, work,
+             leaf_workspace (s->task_levels, s->threads, level)
+             * sizeof (double));
+    return;
+  }
+
+  const int h = n / 2;
+  const size_t hh = (size_t)h * h;
+  const double *A11 = A, *A12 = A + h, *A21 = A + (size_t)h * lda,
+    *A22 = A21 + h;
+  const double *B11 = B, *B12 = B + h, *B21 = B + (size_t)h * ldb,
+    *B22 = B21 + h;
+  double *C11 = C, *C12 = C + h, *C21 = C + (size_t)h * ldc, *C22 = C21 + h;
+
+  double *S1 = work, *S2 = S1 + hh, *S3 = S2 + hh, *S4 = S3 + hh;
+  double *T1 = S4 + hh, *T2 = T1 + hh, *T3 = T2 + hh, *T4 = T3 + hh;
+  combine (h, A21, lda, A22, lda, 1, S1);
+  combine (h, S1, h, A11, lda, -1, S2);
+  combine (h, A11, lda, A21, lda, -1, S3);
+  combine (h, A12, lda, S2, h, -1, S4);
+  combine (h, B12, ldb, B11, ldb, -1, T1);
+  combine (h, B22, ldb, T1, h, -1, T2);
+  combine (h, B22, ldb, B12, ldb, -1, T3);
+  combine (h, B21, ldb, T2, h, -1, T4);  /* -T4 */
+
+  double* rest = T4 + hh;
+
+  if (level < s->task_levels) {
+    const size_t child = workspace (h, s->crossover, s->task_levels,
+                                    s->threads, level + 1);
+    const double* X[7] = { A11, A12, S4, A22, S1, S2, S3 };
+    const int ldx[7] = { lda, lda, h, lda, h, h, h };
+    const double* Y[7] = { B11, B21, B22, T4, T1, T2, T3 };
+    const int ldy[7] = { ldb, ldb, ldb, h, h, h, h };
+    double* P = rest;
+    for (int p = 0; p < 7; ++p) {
+#pragma omp task
+      {
+        double* Pp = P + p * hh;
+        memset (Pp, 0, hh * sizeof (double));
+        recurse (s, h, X[p], ldx[p], Y[p], ldy[p], Pp, h,
+                 P + 7 * hh + p * child, level + 1);
+      }
+    }
+#pragma omp taskwait
+
+    const double *P1 = P, *P2 = P1 + hh, *P3 = P2 + hh, *P4 = P3 + hh,
+      *P5 = P4 + hh, *P6 = P5 + hh, *P7 = P6 + hh;  /* P4 is negated */
+    for (int i = 0; i < h; ++i)
+      for (int j = 0; j < h; ++j) {
+        size_t p = (size_t)i * h + j, c = (size_t)i * ldc + j;
+        double u2 = P1[p] + P6[p], u3 = u2 + P7[p];
+        C11[c] += P1[p] + P2[p];
+        C12[c] += u2 + P5[p] + P3[p];
+        C21[c] += u3 + P4[p];
+        C22[c] += u3 + P5[p];
+      }
+    return;
+  }
+
+  double* P = rest;
+  double* next = P + hh;
+
+  memset (P, 0, hh * sizeof (double));
+  recurse (s, h, A11, lda, B11, ldb, P, h, next, level + 1);     /* P1 */
+  accumulate (h, P, C11, ldc);
+  accumulate (h, P, C12, ldc);
+  accumulate (h, P, C21, ldc);
+  accumulate (h, P, C22, ldc);
+
+  recurse (s, h, A12, lda, B21, ldb, C11, ldc, next, level + 1); /* P2 */
+  recurse (s, h, S4, h, B22, ldb, C12, ldc, next, level + 1);    /* P3 */
+  recurse (s, h, A22, lda, T4, h, C21, ldc, next, level + 1);    /* -P4 */
+
+  memset (P, 0, hh * sizeof (double));
+  recurse (s, h, S1, h, T1, h, P, h, next, level + 1);           /* P5 */
+  accumulate (h, P, C12, ldc);
+  accumulate (h, P, C22, ldc);
+
+  memset (P, 0, hh * sizeof (double));
+  recurse (s, h, S2, h, T2, h, P, h, next, level + 1);           /* P6 */
+  accumulate (h, P, C12, ldc);
+  accumulate (h, P, C21, ldc);
+  accumulate (h, P, C22, ldc);
+
+  memset (P, 0, hh * sizeof (double));
+  recurse (s, h, S3, h, T3, h, P, h, next, level + 1);           /* P7 */
+  accumulate (h, P, C21, ldc);
+  accumulate (h, P, C22, ldc);
+}
+
+void mm_strassen (strassen_t* s, double* C, const double* A, const double* B)
+{
+  assert (s && C && A && B);
+  if (s->task_levels > 0 && !is_leaf (s->n, s->crossover)) {
+#pragma omp parallel
+#pragma omp single
+    recurse (s, s->n, A, s->n, B, s->n, C, s->n, s->arena, 0);
+  } else {
+    recurse (s, s->n, A, s->n, B, s->n, C, s->n, s->arena, 0);
+  }
+}
+
+// eof
@@ -0,0 +1,50 @@
+/**
+ *  \file strassen.hh
+ *  \brief Strassen-Winograd multiply on top of the packed GEMM
+ *
+ *  Each level splits the square operands into quadrants and forms the
+ *  product from 7 half-size multiplies and 15 additions (Winograd's
+ *  variant of Strassen), recursing until the size drops to the crossover
+ *  or becomes odd, where gemm() takes over.
+ *
+ *  All temporaries, the leaves' packed copies included (see gemm_ws()),
+ *  come from one arena allocated by strassen_init(); the recursion itself
+ *  never allocates. On the first 'task_levels' levels the 7 products run
+ *  as OpenMP tasks, each into its own buffer; below that they run one
+ *  after another, sharing one buffer, and the leaf multiplies use every
+ *  thread themselves.
+ *
+ *  The arena is laid out for the GEMM settings and thread count current
+ *  at strassen_init(); change either and call it again.
+ */
+
+#if !defined (INC_STRASSEN_HH)
+#define INC_STRASSEN_HH
+
+#include <stddef.h>
+
+#define STRASSEN_CROSSOVER 512 /*!< Default size handed to gemm() */
+
+struct strassen_t {
+  int n;              /*!< Size the arena was laid out for */
+  int crossover;      /*!< Sizes at or below this go to gemm() */
+  int task_levels;    /*!< Levels whose products run as parallel tasks */
+  int threads;        /*!< Threads the leaves' packing space is for */
+  double* arena;
+  size_t arena_size;  /*!< In doubles */
+};
+
+/** Doubles of workspace an n x n multiply needs. */
+size_t strassen_workspace (int n, int crossover, int task_levels);
+
+/** Allocates the arena for n x n multiplies. */
+void strassen_init (strassen_t* s, int n, int crossover, int task_levels);
+
+/** C += A * B, all n x n (as given to strassen_init()) and dense. */
+void mm_strassen (strassen_t* s, double* C, const double* A, const double* B);
+
+void strassen_free (strassen_t* s);
+
+#endif
+
+// eof
@@ -0,0 +1,178 @@
+/**
+ *  \file tune.cc
+ *  \brief Search for the GEMM micro-tile and blocking on this machine
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include "tune.hh"
+
+#define MAX_SB_SIZES 64
+#define CACHE_JUMP 1.5 /*!< Slowdown that marks a cache boundary */
+#define TUNE_REPS 2    /*!< Timed runs per candidate; the fastest counts */
+
+bool tune_read_sb (const char* filename, cache_sizes_t* caches)
+{
+  FILE* fp = fopen (filename, "r");
+  if (!fp)
+    return false;
+
+  /* Slowest read for each array size, in file order */
+  long sizes[MAX_SB_SIZES];
+  double worst[MAX_SB_SIZES];
+  int count = 0;
+  char line[256];
+  while (fgets (line, sizeof (line), fp)) {
+    long n, stride;
+    double t;
+    if (sscanf (line, "%ld %ld %lf", &n, &stride, &t) != 3)
+      continue;
+    if (count == 0 || sizes[count - 1] != n) {
+      if (count == MAX_SB_SIZES)
+        break;
+      sizes[count] = n;
+      worst[count++] = t;
+    } else if (t > worst[count - 1]) {
+      worst[count - 1] = t;
+    }
+  }
+  fclose (fp);
+
+  long levels[MAX_SB_SIZES];
+  int num_levels = 0;
+  for (int i = 1; i < count; ++i)
+    if (worst[i] > CACHE_JUMP * worst[i - 1])
+      levels[num_levels++] = sizes[i - 1] * sizeof (int);
+  if (num_levels == 0)
+    return false;
+
+  caches->l1 = levels[0];
+  caches->l2 = num_levels > 2 ? levels[1] : 0;
+  caches->l3 = num_levels > 1 ? levels[num_levels - 1] : 0;
+  return true;
+}
+
+/** v rounded down to a multiple of 'unit', but at least 'unit'. */
+static int round_to (long v, int unit)
+{
+  return v < unit ? unit : (int)(v / unit * unit);
+}
+
+gemm_config_t tune_seed (const cache_sizes_t* caches, int mr, int nr)
+{
+  gemm_config_t cfg = { mr, nr, GEMM_MC, GEMM_KC, GEMM_NC };
+  if (caches->l1 > 0)
+    cfg.kc = round_to (caches->l1 / 2 / (nr * (long)sizeof (double)), 8);
+  if (caches->l2 > 0)
+    cfg.mc = round_to (caches->l2 / 2 / (cfg.kc * (long)sizeof (double)), mr);
+  else
+    cfg.mc = round_to (cfg.mc, mr);
+  if (caches->l3 > 0)
+    cfg.nc = round_to (caches->l3 / 2 / (cfg.kc * (long)sizeof (double)), nr);
+  else
+    cfg.nc = round_to (cfg.nc, nr);
+  return cfg;
+}
+
+/** Fastest of TUNE_REPS runs of mm_blis() under 'cfg', in GFLOP/s. */
+static double measure (const gemm_config_t* cfg, double* C, const double* A,
+                       const double* B, int size)
+{
+  bool ok = gemm_set_config (cfg);
+  assert (ok);
+  double best = 0;
+  for (int rep = 0; rep < TUNE_REPS; ++rep) {
+    double t = omp_get_wtime ();
+    mm_blis (C, A, B, size, size, size);
+    t = omp_get_wtime () - t;
+    double rate = 2.0 * size * size * size / t * 1e-9;
+    if (rate > best)
+      best = rate;
+  }
+  gemm_config_t c = gemm_get_config ();
+  printf ("  %2dx%-2d  mc %5d  kc %5d  nc %6d  %8.3f GFLOP/s\n", c.mr, c.nr,
+          c.mc, c.kc, c.nc, best);
+  fflush (stdout);
+  return best;
+}
+
+/**
+ *  Tries 'field' at each of the 'num' multiples in 'factors' of its value
+ *  in *best, keeping the fastest in *best and *best_rate.
+ */
+static void sweep (gemm_config_t* best, double* best_rate,
+                   int gemm_config_t::* field, const double* factors, int num,
+                   double* C, const double* A, const double* B, int size)
+{
+  const gemm_config_t center = *best;
+  for (int i = 0; i < num; ++i) {
+    gemm_config_t cfg = center;
+    cfg.*field = (int)(center.*field * factors[i]);
+    if (cfg.*field <= 0)
+      continue;
+    double rate = measure (&cfg, C, A, B, size);
+    if (rate > *best_rate) {
+      *best_rate = rate;
+      *best = gemm_get_config ();
+    }
+  }
+}
+
+double tune_gemm (int size, const cache_sizes_t* caches)
+{
+  static const cache_sizes_t none = { 0, 0, 0 };
+  static const double factors[] = { 0.5, 0.75, 1.5, 2 };
+  const int num_factors = sizeof (factors) / sizeof (factors[0]);
+  assert (size > 0);
+  if (!caches)
+    caches = &none;
+
+  double* A = (double *)malloc ((size_t)size * size * sizeof (double));
+  double* B = (double *)malloc ((size_t)size * size * sizeof (double));
+  double* C = (double *)calloc ((size_t)size * size, sizeof (double));
+  assert (A && B && C);
+  for (size_t i = 0; i < (size_t)size * size; ++i) {
+    A[i] = drand48 ();
+    B[i] = drand48 ();
+  }
+
+  /* Micro-tile first, each at its own seed blocking */
+  printf ("Tuning on %dx%dx%d, %d thread(s): micro-tile\n", size, size, size,
+          omp_get_max_threads ());
+  const int (*shapes)[2];
+  int num_shapes = gemm_tile_shapes (&shapes);
+  gemm_config_t best = tune_seed (caches, shapes[0][0], shapes[0][1]);
+  double best_rate = 0;
+  for (int i = 0; i < num_shapes; ++i) {
+    gemm_config_t cfg = tune_seed (caches, shapes[i][0], shapes[i][1]);
+    double rate = measure (&cfg, C, A, B, size);
+    if (rate > best_rate) {
+      best_rate = rate;
+      best = gemm_get_config ();
+    }
+  }
+
+  /* Then each block size in turn, innermost first */
+  printf ("KC\n");
+  sweep (&best, &best_rate, &gemm_config_t::kc, factors, num_factors, C, A, B,
+         size);
+  printf ("MC\n");
+  sweep (&best, &best_rate, &gemm_config_t::mc, factors, num_factors, C, A, B,
+         size);
+  printf ("NC\n");
+  sweep (&best, &best_rate, &gemm_config_t::nc, factors, num_factors, C, A, B,
+         size);
+
+  bool ok = gemm_set_config (&best);
+  assert (ok);
+  free (A);
+  free (B);
+  free (C);
+  return best_rate;
+}
+
+// eof
@@ -0,0 +1,46 @@
+/**
+ *  \file tune.hh
+ *  \brief Search for the GEMM micro-tile and blocking on this machine
+ *
+ *  The starting point comes from the cache sizes, either the defaults or
+ *  those sb.cc measured: KC so that a KC x NR sliver of B fills half of
+ *  L1, MC so that the MC x KC block of A fills half of L2, and NC so
+ *  that the KC x NC panel of B fills half of L3. The tuner then times
+ *  mm_blis() on a square problem for every micro-tile shape, and for
+ *  KC, MC and NC in turn at a few multiples of the current value,
+ *  keeping whatever is fastest.
+ */
+
+#if !defined (INC_TUNE_HH)
+#define INC_TUNE_HH
+
+#include "gemm.hh"
+
+/** Cache capacities in bytes; 0 where unknown. */
+struct cache_sizes_t {
+  long l1, l2, l3;
+};
+
+/**
+ *  Reads the output of sb.cc (lines of "n stride seconds", n in ints)
+ *  and reports a cache boundary wherever the slowest read of an array
+ *  size jumps by half again over the next smaller size. The first
+ *  boundary is L1, the last the last-level cache, and one in between, if
+ *  found, L2. Returns false if the file cannot be read or shows no
+ *  boundary.
+ */
+bool tune_read_sb (const char* filename, cache_sizes_t* caches);
+
+/** Blocking for an mr x nr micro-tile derived from 'caches'. */
+gemm_config_t tune_seed (const cache_sizes_t* caches, int mr, int nr);
+
+/**
+ *  Tunes on size x size x size multiplies, starting from 'caches' (or the
+ *  default blocking if NULL), printing each trial. Makes the best
+ *  settings current and returns their GFLOP/s.
+ */
+double tune_gemm (int size, const cache_sizes_t* caches);
+
+#endif
+
+// eof